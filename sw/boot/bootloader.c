@@ -0,0 +1,342 @@
+/**
+ * @file bootloader.c
+ * @brief UART bootloader for field firmware updates
+ *
+ * Lives in the boot section (BOOT_START, 2048 words, BOOTSZ fuses in
+ * main.c). The BOOTRST fuse points the reset vector here:
+ * - With a valid application and no update request, it jumps to it right
+ *   away. The boot time doesn't change.
+ * - The "update" shell command jumps here with BOOT_MAGIC in GPIOR0. If the
+ *   host stays silent for about 8s, the application is restarted.
+ * - Without a valid application (e.g. an interrupted update), it waits for
+ *   the host forever.
+ *
+ * Protocol over UART2, at the BAUD rate of config.h (see tools/upload.c).
+ * Numbers are big endian, and CRCs are CRC-16/XMODEM. Every command is
+ * answered with BOOT_ACK or BOOT_NAK; unknown bytes are ignored, so the
+ * host resyncs by sending BOOT_CMD_SYNC until BOOT_ID comes back.
+ *
+ *   'S'                                        sync: answered with BOOT_ID
+ *   'P' page(2) data(SPM_PAGESIZE) crc(2)      write a page (crc of page
+ *                                              number and data)
+ *   'D' pages(2) crc(2)                        done: crc of the whole image
+ *
+ * A page is erased, written and read back before it is acknowledged, so the
+ * host only resends what failed. The info page, just below the boot
+ * section, tells whether the application is valid:
+ * - BOOT_INFO_MAGIC: written after an update, once the whole image CRC
+ *   matches
+ * - BOOT_INFO_BUSY: written with the first page of an update, so an
+ *   interrupted update is detected at the next reset
+ * - Erased: the application was programmed through the ISP (the chip erase
+ *   clears the info page). It's valid if its reset vector is programmed; its
+ *   CRC isn't known, so it isn't checked.
+ *
+ * After an update, a watchdog reset starts the new application with the
+ * peripherals as after power up.
+ *
+ * The EEPROM is never touched, so the user settings survive the update.
+ * No interrupts are used: the UART and the timeout timer are polled. The
+ * reset flags (MCUSR) are handed over to the application in GPIOR1. The
+ * watchdog resets done here are marked in a RAM section that isn't
+ * initialized at startup: they're handed over as BOOT_RESET_UPDATE or
+ * BOOT_RESET_IDLE instead of WDRF, so the application doesn't log them as a
+ * hang.
+ *
+ * Build and program (from sw/), once per board through the ISP:
+ *   make bootloader
+ *   make program_bootloader
+ *
+ * @date 19.10.2026
+ *
+ */
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include "config.h"
+
+#include <avr/boot.h>
+#include <avr/eeprom.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
+#include <stdint.h>
+#include <util/crc16.h>
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Application info page: last page below the boot section
+#define BOOT_INFO		(BOOT_START - SPM_PAGESIZE)
+#define BOOT_INFO_MAGIC	0xB007
+#define BOOT_INFO_BUSY	0x0000
+#define BOOT_ERASED		0xFFFF
+// Pages available to the application
+#define BOOT_PAGES		(BOOT_INFO / SPM_PAGESIZE)
+
+// Commands and replies
+#define BOOT_CMD_SYNC	'S'
+#define BOOT_CMD_PAGE	'P'
+#define BOOT_CMD_DONE	'D'
+#define BOOT_ID			'B'
+#define BOOT_ACK		'K'
+#define BOOT_NAK		'E'
+
+// Always double speed: 125000 baud is exact, 19200 baud is off by 0.2%
+#define BOOT_UBRR		((F_CPU + 4UL * BAUD) / (8UL * BAUD) - 1)
+
+// Idle time before going back to the application: TC1 overflow, at F_CPU/256
+#define BOOT_TIMEOUT_PRESCALER	(1<<CS12)	// 8.4s
+
+// Marks a watchdog reset done by the bootloader. Any other value in RAM (the
+// application used it since) means it wasn't
+#define BOOT_RESTART_MAGIC		0x5AA5
+
+/******************************************************************************
+*************** G L O B A L   V A R S   D E F I N I T I O N S *****************
+******************************************************************************/
+
+static uint8_t page[SPM_PAGESIZE];
+static uint8_t tx_used = FALSE;
+// Survive the watchdog reset: not initialized at startup
+static uint16_t restart_magic __attribute__((section(".noinit")));
+static uint8_t restart_flag __attribute__((section(".noinit")));
+
+/******************************************************************************
+******************* F U N C T I O N   D E F I N I T I O N S *******************
+******************************************************************************/
+
+static uint8_t app_valid(void);
+static void restart(uint8_t flag);
+static uint8_t get_char(void);
+static void send_char(uint8_t c);
+static uint16_t get_word(void);
+static uint8_t cmd_page(void);
+static uint8_t cmd_done(void);
+static uint8_t write_page(uint16_t addr);
+static void write_info(uint16_t magic, uint16_t n, uint16_t crc);
+static uint16_t crc_word(uint16_t crc, uint16_t w);
+
+/*===========================================================================*/
+int main(void)
+{
+	uint8_t c, ok;
+
+	/*
+	* The watchdog keeps running after a watchdog reset, until WDRF is
+	* cleared. The flags go to the application in GPIOR1
+	*/
+	c = MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+	if((c & (1<<WDRF)) && (restart_magic == BOOT_RESTART_MAGIC))
+		c = (c & ~(1<<WDRF)) | restart_flag;
+	restart_magic = 0;
+	GPIOR1 = c;
+
+	c = GPIOR0;
+	GPIOR0 = 0;
+	if((c != BOOT_MAGIC) && app_valid()) ((void (*)(void))0)();
+
+	UBRR2 = BOOT_UBRR;
+	UCSR2A = (1<<U2X);
+	UCSR2C = (1<<UCSZ1) | (1<<UCSZ0);
+	UCSR2B = (1<<RXEN) | (1<<TXEN);
+	/*
+	* After the "update" command, TC1 is left as the application used it
+	* (LEDs PWM, in 8 bits mode): back to normal mode before timing out
+	*/
+	TCCR1B = 0;
+	TIMSK1 = 0;
+	TCCR1A = 0;
+	TCCR1C = 0;
+	TCNT1 = 0;
+	TIFR1 = (1<<ICF1) | (1<<OCF1B) | (1<<OCF1A) | (1<<TOV1);
+	TCCR1B = BOOT_TIMEOUT_PRESCALER;
+
+	while(1){
+		c = get_char();
+		if(c == BOOT_CMD_SYNC){
+			send_char(BOOT_ID);
+			continue;
+		}
+		if(c == BOOT_CMD_PAGE) ok = cmd_page();
+		else if(c == BOOT_CMD_DONE) ok = cmd_done();
+		else continue;
+		send_char(ok ? BOOT_ACK : BOOT_NAK);
+		if((c == BOOT_CMD_DONE) && ok) restart(BOOT_RESET_UPDATE);
+	}
+}
+
+/*-----------------------------------------------------------------------------
+-------------------------- L O C A L   F U N C T I O N S ----------------------
+-----------------------------------------------------------------------------*/
+
+/*===========================================================================*/
+/*
+* The application is valid once its info page has been written. Its CRC was
+* checked at that time; checking it on every reset would delay the boot. An
+* erased info page comes from the ISP: the application is valid if it's
+* there at all
+*/
+static uint8_t app_valid(void)
+{
+	uint16_t magic = pgm_read_word(BOOT_INFO);
+
+	if(magic == BOOT_INFO_MAGIC) return TRUE;
+	return (magic == BOOT_ERASED) && (pgm_read_word(0) != BOOT_ERASED);
+}
+
+/*===========================================================================*/
+/*
+* Watchdog reset, once the last reply is out. The application then starts
+* from a clean state, whatever the previous one left behind. The flag tells
+* it why
+*/
+static void restart(uint8_t flag)
+{
+	if(tx_used) while(!(UCSR2A & (1<<TXC)));
+	restart_flag = flag;
+	restart_magic = BOOT_RESTART_MAGIC;
+	wdt_enable(WDTO_15MS);
+	while(1);
+}
+
+/*===========================================================================*/
+/*
+* Waits for a byte. Every byte restarts the idle timeout, which only
+* restarts the application if it is still valid
+*/
+static uint8_t get_char(void)
+{
+	while(!(UCSR2A & (1<<RXC))){
+		if(TIFR1 & (1<<TOV1)){
+			TIFR1 = (1<<TOV1);
+			if(app_valid()) restart(BOOT_RESET_IDLE);
+		}
+	}
+	TCNT1 = 0;
+	return UDR2;
+}
+
+/*===========================================================================*/
+static void send_char(uint8_t c)
+{
+	while(!(UCSR2A & (1<<UDRE)));
+	UCSR2A |= (1<<TXC);
+	UDR2 = c;
+	tx_used = TRUE;
+}
+
+/*===========================================================================*/
+static uint16_t get_word(void)
+{
+	uint16_t w = (uint16_t)get_char() << 8;
+
+	return w | get_char();
+}
+
+/*===========================================================================*/
+/*
+* 'P' command: receives a page, and writes it if its CRC is right. The first
+* page written marks the update in progress, which invalidates the
+* application
+*/
+static uint8_t cmd_page(void)
+{
+	uint16_t n, crc, i;
+
+	n = get_word();
+	crc = crc_word(0, n);
+	for(i = 0; i < SPM_PAGESIZE; i++){
+		page[i] = get_char();
+		crc = _crc_xmodem_update(crc, page[i]);
+	}
+	if(get_word() != crc) return FALSE;
+	if(n >= BOOT_PAGES) return FALSE;
+
+	if(pgm_read_word(BOOT_INFO) != BOOT_INFO_BUSY) write_info(BOOT_INFO_BUSY, 0, 0);
+	return write_page(n * SPM_PAGESIZE);
+}
+
+/*===========================================================================*/
+/*
+* 'D' command: checks the CRC of the whole image in FLASH, and writes the
+* info page that makes it a valid application
+*/
+static uint8_t cmd_done(void)
+{
+	uint16_t n, crc, addr;
+	uint16_t image_crc = 0;
+
+	n = get_word();
+	crc = get_word();
+	if(!n || (n > BOOT_PAGES)) return FALSE;
+	for(addr = 0; addr < n * SPM_PAGESIZE; addr++)
+		image_crc = _crc_xmodem_update(image_crc, pgm_read_byte(addr));
+	if(image_crc != crc) return FALSE;
+
+	write_info(BOOT_INFO_MAGIC, n, crc);
+	return pgm_read_word(BOOT_INFO) == BOOT_INFO_MAGIC;
+}
+
+/*===========================================================================*/
+/*
+* Erases and writes a page from the buffer, and reads it back. The
+* application section (RWW) is written from here (NRWW), so the CPU keeps
+* running during the erase and write
+*/
+static uint8_t write_page(uint16_t addr)
+{
+	uint8_t i;
+
+	// SPM doesn't work while the EEPROM is being written
+	eeprom_busy_wait();
+	boot_page_erase(addr);
+	boot_spm_busy_wait();
+	for(i = 0; i < SPM_PAGESIZE; i += 2)
+		boot_page_fill(addr + i, page[i] | (page[i + 1] << 8));
+	boot_page_write(addr);
+	boot_spm_busy_wait();
+	boot_rww_enable();
+
+	for(i = 0; i < SPM_PAGESIZE; i++)
+		if(pgm_read_byte(addr + i) != page[i]) return FALSE;
+	return TRUE;
+}
+
+/*===========================================================================*/
+/*
+* Writes the info page: magic number, number of pages and CRC of the image
+* (little endian words), the rest erased. The page buffer isn't used, as it
+* may hold the page being written
+*/
+static void write_info(uint16_t magic, uint16_t n, uint16_t crc)
+{
+	uint8_t i;
+	uint16_t w;
+
+	eeprom_busy_wait();
+	boot_page_erase(BOOT_INFO);
+	boot_spm_busy_wait();
+	for(i = 0; i < SPM_PAGESIZE; i += 2){
+		if(i == 0) w = magic;
+		else if(i == 2) w = n;
+		else if(i == 4) w = crc;
+		else w = BOOT_ERASED;
+		boot_page_fill(BOOT_INFO + i, w);
+	}
+	boot_page_write(BOOT_INFO);
+	boot_spm_busy_wait();
+	boot_rww_enable();
+}
+
+/*===========================================================================*/
+static uint16_t crc_word(uint16_t crc, uint16_t w)
+{
+	crc = _crc_xmodem_update(crc, w >> 8);
+	return _crc_xmodem_update(crc, w & 0xFF);
+}
@@ -14,22 +14,31 @@
 ******************************************************************************/
 
 #include "adc.h"
+#include "clock.h"
 #include "config.h"
+#include "external_interrupt.h"
+#include "fixed.h"
+#include "log.h"
+#include "telemetry.h"
 #include "uart.h"
 
+#include <avr/interrupt.h>
 #include <avr/io.h>
 #include <avr/pgmspace.h>
 #include <stdint.h>
-#include <stdlib.h>
 #include <util/delay.h>
 
 /******************************************************************************
 ******************* C O N S T A N T   D E F I N I T I O N S *******************
 ******************************************************************************/
 
+// Tag of the log messages (see log.h)
+#define LOG_TAG		"adc"
+
 #define	ADC_PS_DIV8		(1<<ADPS1 | 1<<ADPS0)
 #define	ADC_PS_DIV16	(1<<ADPS2)
 #define	ADC_PS_DIV128	(1<<ADPS2 | 1<<ADPS1 | 1<<ADPS0)
+#define ADC_PS_MASK		ADC_PS_DIV128
 #define ADC_MUX_MASK	(1<<MUX4 | 1<<MUX3 | 1<<MUX2 | 1<<MUX1 | 1<<MUX0)
 
 #define ADC_V_HV		0										/* ADC0 */
@@ -39,18 +48,65 @@
 #define ADC_V_REF 		(1<<MUX4 | 1<<MUX3 | 1<<MUX2 | 1<<MUX1)	/* V_REF */
 
 /* 
-* ADC nominal voltages:
+* ADC nominal voltages (mV):
+*/
+#define V_HV  			3794	// nominal 160V
+#define V_HV_OFF		273		// nominal 11.5V
+#define V_CTL_REG 		2120	// nominal 8V
+#define V_CTL_REG_OFF 	0		// nominal 0V
+#define V_IN 			3010	// nominal 11.4V
+#define V_REF 			1100	// nominal 1.1V
+#define V_DD 			4300	// nominal MCU voltage v_dd
+
+// Resistor dividers factors
+#define DIV_HV			UQ6_10(42.2)
+#define DIV_CTL_REG		UQ6_10(3.78)
+#define DIV_IN			UQ6_10(3.78)
+#define DIV_NONE		UQ6_10(1.0)
+
+/*
+* Oversampling and decimation: 4^n readings added and divided by 2^n give n
+* extra bits. All readings are 12 bits (0 to FX_ADC_TOP), both from
+* adc_read() and from the background sampler.
 */
-#define V_HV  			((float) 3.794)	// nominal 160V
-#define V_HV_OFF		((float) 0.273)	// nominal 11.5V
-#define V_CTL_REG 		((float) 2.12)	// nominal 8V
-#define V_CTL_REG_OFF 	((float) 0.0)	// nominal 0V
-#define V_IN 			((float) 3.01)	// nominal 11.4V
-#define V_REF 			((float) 1.1)	// nominal 1.1V
-#define V_DD 			((float) 4.3)	// nominal MCU voltage v_dd
+#define ADC_OS_BITS		2
+#define ADC_OS_N		(1 << (2 * ADC_OS_BITS))
+
+// Background sampler readings kept per channel. Must be a power of 2
+#define ADC_RING_SIZE	ADC_OS_N
+#define ADC_RING_MASK	(ADC_RING_SIZE - 1)
+// Consecutive out of window readings of a rail to raise a fault
+#define ADC_FAULT_COUNT	20
+// Sequence slot whose reading is discarded
+#define ADC_CH_NONE		0xFF
+
+// High voltage fast shutdown threshold (mV at the ADC pin). A reading at
+// full scale also trips: with a low rail, the threshold can't be measured
+#define ADC_HV_TRIP		((V_HV * 112UL) / 100)
+#define ADC_FULL_SCALE	1023		// single conversion, 10 bits
+
+// High voltage settle detector: the filtered value (sum of the ring) is
+// checked once per sampler sequence. It's settled once it's inside the
+// window and changes less than ADC_SETTLE_TOL (% of nominal) for
+// ADC_SETTLE_COUNT checks in a row
+#define ADC_SETTLE_TOL		2
+#define ADC_SETTLE_COUNT	3
 
-// ADC "oversampling", i.e. # of ADC readings per channel
-#define ADC_READ_N		5
+/*
+* Background sampler sequence: one conversion per ms. The internal reference
+* needs a long settling time after it's selected, so its first conversion is
+* discarded. The high voltage is sampled every 2ms, and the other channels
+* every 8ms.
+*/
+static const uint8_t seq_mux[] PROGMEM = {
+	ADC_V_HV, ADC_V_CTL_REG, ADC_V_HV, ADC_V_IN,
+	ADC_V_HV, ADC_V_REF, ADC_V_HV, ADC_V_REF
+};
+static const uint8_t seq_ch[] PROGMEM = {
+	ADC_CH_HV, ADC_CH_CTL_REG, ADC_CH_HV, ADC_CH_IN,
+	ADC_CH_HV, ADC_CH_NONE, ADC_CH_HV, ADC_CH_REF
+};
+#define ADC_SEQ_LEN		sizeof(seq_ch)
 
 // Structure for the ADC voltage measurements
 typedef struct {
@@ -61,11 +117,47 @@ typedef struct {
 	uint8_t good;		// flag, value measured out of range
 } voltage_s;
 
+// Supply monitor window of a rail (mV at the ADC pin)
+typedef struct {
+	uint16_t lo;
+	uint16_t hi;
+} window_s;
+
+// Same limits as adc_voltages_test(), indexed by channel
+static const window_s windows[] PROGMEM = {
+	{(V_HV * 85UL) / 100, (V_HV * 115UL) / 100},
+	{(V_CTL_REG * 85UL) / 100, (V_CTL_REG * 115UL) / 100},
+	{(V_IN * 80UL) / 100, (V_IN * 120UL) / 100}
+};
+
+/******************************************************************************
+*************** G L O B A L   V A R S   D E F I N I T I O N S *****************
+******************************************************************************/
+
+// Background sampler state
+static volatile uint8_t sampler = FALSE;
+static volatile uint8_t monitor = FALSE;
+static volatile uint8_t faults = 0;
+static uint16_t ring[ADC_CH_N][ADC_RING_SIZE];
+static volatile uint16_t sum[ADC_CH_N];		// sum of each ring
+static uint8_t ring_idx[ADC_CH_N];
+static uint8_t rounds = 0;					// complete sequences, up to ring size
+static uint8_t seq = 0;
+static uint8_t fault_cnt[ADC_CH_REF];
+
+// Conversion start time (1ms ticks and TC3 count), and the time from the
+// start of the conversion to the boost shutdown (us)
+static uint8_t conv_ms = 0;
+static uint8_t conv_tcnt = 0;
+static uint16_t trip_latency = 0;
+
 /******************************************************************************
 ******************* F U N C T I O N   D E F I N I T I O N S *******************
 ******************************************************************************/
 
-static void convert_and_send(uint16_t v, float c, float what, float v_dd);
+static void convert_and_send(uint16_t v, uq6_10_t c, uint16_t what, uint16_t v_ref_raw);
+static void sampler_start(void);
+static void sampler_stop(void);
 
 /*===========================================================================*/
 /* 
@@ -80,19 +172,48 @@ void adc_init(void)
 }
 
 /*===========================================================================*/
+/*
+* Enabling the ADC also starts the background sampler
+*/
 void adc_set(uint8_t state){
 
-	if(state)
+	if(state){
 		ADCSRA |= (1<<ADEN);		// Enable ADC conversions
-	else
+		sampler_start();
+	} else {
+		sampler_stop();
 		ADCSRA &= ~(1<<ADEN);		// Disable ADC conversions
+	}
+}
+
+/*===========================================================================*/
+/*
+* Keeps the ADC clock at 125KHz for a new CPU clock speed. An ongoing
+* conversion is completed first. ADIF is written as 0, so a pending result
+* isn't lost. Called by clock_set()
+*/
+void adc_clock(uint8_t speed)
+{
+	uint8_t ps = (speed == CLK_FAST) ? ADC_PS_DIV128 : ADC_PS_DIV16;
+
+	while(ADCSRA & (1<<ADSC));
+	ADCSRA = (ADCSRA & ~((1<<ADIF) | ADC_PS_MASK)) | ps;
 }
 
 /*===========================================================================*/
+/*
+* Single channel reading, oversampled and decimated to 12 bits. The ADC runs
+* in free running mode: one conversion right after the other, ADC_OS_N of
+* them after a discarded first one (the channel has just been switched).
+*/
 uint16_t adc_read(uint8_t adcx)
 {	
 	uint8_t i;
-	uint16_t avg = 0;
+	uint16_t acc = 0;
+	uint8_t resume = sampler;
+
+	// the background sampler is paused (and restarted with empty rings)
+	if(resume) sampler_stop();
 
 	ADMUX &= ~(ADC_MUX_MASK);		// Clear ADC mux selection
 	ADMUX |= adcx;					// Select proper ADC channel
@@ -100,17 +221,218 @@ uint16_t adc_read(uint8_t adcx)
 	// to stabilize voltage
 	if(adcx == ADC_V_REF) _delay_us(200);
 	else _delay_us(20);
-	ADCSRA |= (1<<ADSC);			// This starts the conversion
-	
-	// perform n reads and accumulate them in a temporary variable
-	for (i = 0; i < ADC_READ_N; i++){
-		while ((ADCSRA & (1<<ADSC)));	// Wait 'til conversion completed
-		avg += ADC;
+	ADCSRB &= ~(1<<ADTS2 | 1<<ADTS1 | 1<<ADTS0);	// free running
+	ADCSRA |= (1<<ADIF) | (1<<ADATE) | (1<<ADSC);	// start conversions
+
+	// every conversion sets ADIF. Clear it and add the result
+	for (i = 0; i <= ADC_OS_N; i++){
+		while (!(ADCSRA & (1<<ADIF)));
+		ADCSRA |= (1<<ADIF);
+		if(i) acc += ADC;
 	}
-	// average the ADC reads
-	avg = avg / ((uint16_t)ADC_READ_N);	// average value	
+	ADCSRA &= ~(1<<ADATE);			// stops after the ongoing conversion
+	while (ADCSRA & (1<<ADSC));
+	ADCSRA |= (1<<ADIF);
 	
-	return avg;
+	if(resume) sampler_start();
+	return acc >> ADC_OS_BITS;
+}
+
+/*===========================================================================*/
+/*
+* Executed every 1ms from the general timer ISR: starts the next conversion
+* of the background sampler
+*/
+void adc_tick(void)
+{
+	conv_ms++;
+	if(sampler && !(ADCSRA & (1<<ADSC))){
+		ADCSRA |= (1<<ADSC);
+		conv_ms = 0;
+		conv_tcnt = (uint8_t)TCNT3;
+	}
+}
+
+/*===========================================================================*/
+/*
+* Background sampler. Executed from the ADC conversion complete ISR.
+* - The reading is stored in the channel's ring, and its running sum updated
+* - The next channel of the sequence is selected right away, so the input
+*   settles until the next conversion starts
+* - If the supply monitor is enabled, each rail is compared with its window.
+*   Both the rail and the reference are filtered; the rail voltage is
+*   rail * V_REF / ref, and it's compared without any division.
+* - High voltage fast path: a single reading above ADC_HV_TRIP disables the
+*   boost right here, before anything else.
+* Returns TRUE when a new fault is raised
+*/
+uint8_t adc_isr(void)
+{
+	uint16_t val = ADC;
+	uint8_t ch = pgm_read_byte(&seq_ch[seq]);
+	uint8_t i;
+	uint32_t v, r;
+
+	if((ch == ADC_CH_HV) && monitor && (rounds >= ADC_RING_SIZE)){
+		if((val >= ADC_FULL_SCALE) ||
+			(((uint32_t)val * V_REF * ADC_RING_SIZE) > (ADC_HV_TRIP * (uint32_t)sum[ADC_CH_REF]))){
+			BOOST_SET(DISABLE);
+			// TC3 counts 4us ticks, 250 per ms
+			trip_latency = (((uint16_t)conv_ms * 250) + (uint8_t)TCNT3 - conv_tcnt) * 4;
+			faults |= ADC_FAULT_HV_TRIP;
+			monitor = FALSE;
+			return TRUE;
+		}
+	}
+
+	seq++;
+	if(seq >= ADC_SEQ_LEN){
+		seq = 0;
+		if(rounds < ADC_RING_SIZE) rounds++;
+	}
+	ADMUX = (ADMUX & ~(ADC_MUX_MASK)) | pgm_read_byte(&seq_mux[seq]);
+
+	if(ch == ADC_CH_NONE) return FALSE;
+	i = ring_idx[ch];
+	sum[ch] = sum[ch] - ring[ch][i] + val;
+	ring[ch][i] = val;
+	ring_idx[ch] = (i + 1) & ADC_RING_MASK;
+
+	// supply monitor. Rails go down when the adapter is removed: that's
+	// handled by the external power ISR
+	if(!monitor || (ch == ADC_CH_REF) || (rounds < ADC_RING_SIZE) || !EXT_PWR)
+		return FALSE;
+	v = (uint32_t)sum[ch] * V_REF;
+	r = sum[ADC_CH_REF];
+	if((v < (pgm_read_word(&windows[ch].lo) * r)) || (v > (pgm_read_word(&windows[ch].hi) * r))){
+		if(fault_cnt[ch] < ADC_FAULT_COUNT){
+			fault_cnt[ch]++;
+			if(fault_cnt[ch] == ADC_FAULT_COUNT){
+				faults |= (1<<ch);
+				return TRUE;
+			}
+		}
+	} else {
+		fault_cnt[ch] = 0;
+	}
+	return FALSE;
+}
+
+/*===========================================================================*/
+/*
+* TRUE once the rings of all channels are full
+*/
+uint8_t adc_ready(void)
+{
+	return (rounds >= ADC_RING_SIZE);
+}
+
+/*===========================================================================*/
+/*
+* Filtered reading of a sampler channel, 12 bits: the ring is decimated
+*/
+uint16_t adc_filtered(uint8_t ch)
+{
+	return sum[ch] >> ADC_OS_BITS;
+}
+
+/*===========================================================================*/
+/*
+* Rail voltages from the filtered readings, in 10mV units: V_HV, V_CTL_REG,
+* V_IN and the MCU rail. Used by the telemetry
+*/
+void adc_rails(uint16_t *cv)
+{
+	uint16_t ref = adc_filtered(ADC_CH_REF);
+
+	cv[0] = (uint16_t)(fx_volts(adc_filtered(ADC_CH_HV), ref, V_REF, DIV_HV) / 10);
+	cv[1] = (uint16_t)(fx_volts(adc_filtered(ADC_CH_CTL_REG), ref, V_REF, DIV_CTL_REG) / 10);
+	cv[2] = (uint16_t)(fx_volts(adc_filtered(ADC_CH_IN), ref, V_REF, DIV_IN) / 10);
+	cv[3] = fx_vdd(ref, V_REF) / 10;
+}
+
+/*===========================================================================*/
+/*
+* Enables the supply monitor. Only once the rails are known to be right
+* (after adc_voltages_test())
+*/
+void adc_monitor(uint8_t state)
+{
+	for(uint8_t i = 0; i < ADC_CH_REF; i++)
+		fault_cnt[i] = 0;
+	faults = 0;
+	monitor = state;
+}
+
+/*===========================================================================*/
+/*
+* Supply monitor faults raised (ADC_FAULT_x bits). They're kept until the
+* monitor is enabled again
+*/
+uint8_t adc_faults(void)
+{
+	return faults;
+}
+
+/*===========================================================================*/
+void adc_report_faults(void)
+{
+	if(faults & ADC_FAULT_HV) LOG_E("Boost voltage out of range");
+	if(faults & ADC_FAULT_CTL_REG) LOG_E("Boost controller regulator voltage out of range");
+	if(faults & ADC_FAULT_IN) LOG_E("Input voltage out of range");
+	if(faults & ADC_FAULT_HV_TRIP) LOG_E("Boost overvoltage. Shut down after (us): %u", trip_latency);
+}
+
+/*===========================================================================*/
+/*
+* Time from the start of the tripping conversion to the boost shutdown (us)
+*/
+uint16_t adc_trip_latency(void)
+{
+	return trip_latency;
+}
+
+/*===========================================================================*/
+/*
+* Waits (with interrupts enabled) until the high voltage is stable, so the
+* boost output can be checked right away instead of after a fixed delay. The
+* boost charges in less than 200ms.
+* Returns the time it took (ms), or ADC_SETTLE_TIMEOUT if it never settled,
+* and reports it through the serial port. Either way, adc_voltages_test() is
+* the one that decides.
+*/
+uint16_t adc_hv_settle(void)
+{
+	uint16_t t = 0;
+	uint16_t hv, prev = 0;
+	uint16_t nom, tol;
+	uint8_t stable = 0;
+
+	if(!sampler) sampler_start();
+	while(t < ADC_SETTLE_TIMEOUT){
+		sei();
+		while(!loop);
+		loop = FALSE;
+		cli();
+		t++;
+		// one check per sequence, once all the rings are full
+		if(!adc_ready() || (t % ADC_SEQ_LEN)) continue;
+
+		nom = fx_counts(V_HV, adc_filtered(ADC_CH_REF), V_REF);
+		tol = fx_percent(nom, ADC_SETTLE_TOL);
+		hv = adc_filtered(ADC_CH_HV);
+		if((hv >= fx_percent(nom, 85)) && (hv <= fx_percent(nom, 115)) &&
+			(((hv > prev) ? (hv - prev) : (prev - hv)) <= tol)){
+			if(++stable >= ADC_SETTLE_COUNT) break;
+		} else {
+			stable = 0;
+		}
+		prev = hv;
+	}
+
+	if(t >= ADC_SETTLE_TIMEOUT) LOG_W("HV settle time (ms): %u - TIMEOUT", t);
+	else LOG_I("HV settle time (ms): %u", t);
+	return t;
 }
 
 /*===========================================================================*/
@@ -119,35 +441,43 @@ uint16_t adc_read(uint8_t adcx)
 * The MCU is NOT directly fed by the 5V rail, but it's placed after a diode.
 * Thus, we rely on the value of the internal reference voltage to deduce the
 * voltage reference for the ADC (the MCU rail voltage)
+* Readings are a snapshot of the background sampler. It only waits (with
+* interrupts enabled) if the sampler has just been started.
 */
 uint8_t adc_voltages_test(void)
 {
 	uint16_t v_ref_raw;
-	float v_dd;
 	voltage_s v_hv, v_ctl_reg, v_in;
 
-	// read internal reference
-	v_ref_raw = adc_read(ADC_V_REF);
-	// based on internal reference value, deduce the ADC reference voltage
-	v_dd = V_REF * 1023.0 / ((float)(v_ref_raw));
+	if(!sampler) sampler_start();
+	while(!adc_ready()){
+		sei();
+		while(!loop);
+		loop = FALSE;
+		cli();
+	}
+
+	// internal reference. The ADC reference voltage (MCU rail) is deduced
+	// from it, and corrects all the computations below
+	v_ref_raw = adc_filtered(ADC_CH_REF);
 	
 	// compute the raw (integer) limit values for each measure
-	v_hv.val_nom = (uint16_t)((V_HV / v_dd) * 1023.0);
-	v_hv.val_min = (uint16_t)(((float)v_hv.val_nom) * 0.85);
-	v_hv.val_max = (uint16_t)(((float)v_hv.val_nom) * 1.15);
+	v_hv.val_nom = fx_counts(V_HV, v_ref_raw, V_REF);
+	v_hv.val_min = fx_percent(v_hv.val_nom, 85);
+	v_hv.val_max = fx_percent(v_hv.val_nom, 115);
 
-	v_ctl_reg.val_nom = (uint16_t)((V_CTL_REG / v_dd) * 1023.0);
-	v_ctl_reg.val_min = (uint16_t)(((float)v_ctl_reg.val_nom) * 0.85);
-	v_ctl_reg.val_max = (uint16_t)(((float)v_ctl_reg.val_nom) * 1.15);
+	v_ctl_reg.val_nom = fx_counts(V_CTL_REG, v_ref_raw, V_REF);
+	v_ctl_reg.val_min = fx_percent(v_ctl_reg.val_nom, 85);
+	v_ctl_reg.val_max = fx_percent(v_ctl_reg.val_nom, 115);
 
-	v_in.val_nom = (uint16_t)((V_IN / v_dd) * 1023.0);
-	v_in.val_min = (uint16_t)(((float)v_in.val_nom) * 0.8);
-	v_in.val_max = (uint16_t)(((float)v_in.val_nom) * 1.2);
+	v_in.val_nom = fx_counts(V_IN, v_ref_raw, V_REF);
+	v_in.val_min = fx_percent(v_in.val_nom, 80);
+	v_in.val_max = fx_percent(v_in.val_nom, 120);
 
-	// measure each voltage individually
-	v_hv.val = adc_read(ADC_V_HV);
-	v_ctl_reg.val = adc_read(ADC_V_CTL_REG);
-	v_in.val = adc_read(ADC_V_IN);
+	// each voltage
+	v_hv.val = adc_filtered(ADC_CH_HV);
+	v_ctl_reg.val = adc_filtered(ADC_CH_CTL_REG);
+	v_in.val = adc_filtered(ADC_CH_IN);
 
 	// compare measured value with the calculated voltage limits
 	if((v_hv.val >= v_hv.val_min) && (v_hv.val <= v_hv.val_max)) v_hv.good = TRUE;
@@ -159,17 +489,21 @@ uint8_t adc_voltages_test(void)
 	if((v_in.val >= v_in.val_min) && (v_in.val <= v_in.val_max)) v_in.good = TRUE;
 	else v_in.good = FALSE;
 	
-	// Report voltages through serial port
-	uart_send_string_p(PSTR("\n\rSYSTEM VOLTAGES:"));
-	convert_and_send(v_hv.val, 42.2, V_HV, v_dd); 			// HIGH VOLTAGE (BOOST CONVERTER OUTPUT)
-	convert_and_send(v_ctl_reg.val, 3.78, V_CTL_REG, v_dd);	// BOOST CONTROLLER INTERNAL REGULATOR
-	convert_and_send(v_in.val, 3.78, V_IN, v_dd);			// INPUT ADAPTER VOLTAGE
-	convert_and_send(1023, 1.0, V_DD, v_dd);				// CALCULATED VOLTAGE RAIL (4.3V ideallly)
+	// Report voltages through serial port. In binary mode, a STATUS frame
+	if(telemetry_mode() == TLM_BINARY){
+		telemetry_status();
+	} else if(LOG_ON(LOG_INFO)){
+		LOG_I("SYSTEM VOLTAGES:");
+		convert_and_send(v_hv.val, DIV_HV, V_HV, v_ref_raw); 		// HIGH VOLTAGE (BOOST CONVERTER OUTPUT)
+		convert_and_send(v_ctl_reg.val, DIV_CTL_REG, V_CTL_REG, v_ref_raw);	// BOOST CONTROLLER INTERNAL REGULATOR
+		convert_and_send(v_in.val, DIV_IN, V_IN, v_ref_raw);		// INPUT ADAPTER VOLTAGE
+		convert_and_send(FX_ADC_TOP, DIV_NONE, V_DD, v_ref_raw);		// CALCULATED VOLTAGE RAIL (4.3V ideallly)
+	}
 
 	// If some voltage is out of range, warn about it
-	if(!v_hv.good) uart_send_string_p(PSTR("\n\rWARING! - Boost voltage out of range"));
-	if(!v_ctl_reg.good) uart_send_string_p(PSTR("\n\rWARING! - Boost controller regulator voltage out of range"));
-	if(!v_in.good) uart_send_string_p(PSTR("\n\rWARNING! - Input voltage out of range"));
+	if(!v_hv.good) LOG_E("Boost voltage out of range");
+	if(!v_ctl_reg.good) LOG_E("Boost controller regulator voltage out of range");
+	if(!v_in.good) LOG_E("Input voltage out of range");
 	
 	// If some voltage is out of range, return false.
 	return ((v_hv.good && v_ctl_reg.good && v_in.good));
@@ -186,7 +520,7 @@ uint8_t adc_factory_test_check(void)
 	uint8_t t = TRUE;
 
 	for(uint8_t i = 0; i < 3; i++){
-		if(adc_read(ADC_V_TST) > 100){
+		if(adc_read(ADC_V_TST) > 400){
 			t = FALSE;
 			break;
 		}
@@ -205,34 +539,34 @@ uint8_t adc_factory_test_check(void)
 void adc_factory_voltages_test(uint8_t boost, uint8_t *p)
 {
 	uint16_t v_ref_raw;
-	float v_dd;
+	uint16_t v_dd;
 	uint8_t v_dd_good;
 	voltage_s v_hv, v_ctl_reg, v_in;
 
 	// read internal reference
 	v_ref_raw = adc_read(ADC_V_REF);
 	// based on internal reference value, deduce the ADC reference voltage
-	v_dd = V_REF * 1023.0 / ((float)(v_ref_raw));	// (float value)
+	v_dd = fx_vdd(v_ref_raw, V_REF);	// (mV)
 	
 	// compute the raw (integer) limit values for each measure
-	if(boost == BOOST_ON) v_hv.val_nom = (uint16_t)((V_HV / v_dd) * 1023.0);
-	else v_hv.val_nom = (uint16_t)((V_HV_OFF / v_dd) * 1023.0);
-	v_hv.val_min = (uint16_t)(((float)v_hv.val_nom) * 0.85);
-	v_hv.val_max = (uint16_t)(((float)v_hv.val_nom) * 1.15);
+	if(boost == BOOST_ON) v_hv.val_nom = fx_counts(V_HV, v_ref_raw, V_REF);
+	else v_hv.val_nom = fx_counts(V_HV_OFF, v_ref_raw, V_REF);
+	v_hv.val_min = fx_percent(v_hv.val_nom, 85);
+	v_hv.val_max = fx_percent(v_hv.val_nom, 115);
 
 	if(boost == BOOST_ON){
-		v_ctl_reg.val_nom = (uint16_t)((V_CTL_REG / v_dd) * 1023.0);
-		v_ctl_reg.val_min = (uint16_t)(((float)v_ctl_reg.val_nom) * 0.85);
-		v_ctl_reg.val_max = (uint16_t)(((float)v_ctl_reg.val_nom) * 1.15);
+		v_ctl_reg.val_nom = fx_counts(V_CTL_REG, v_ref_raw, V_REF);
+		v_ctl_reg.val_min = fx_percent(v_ctl_reg.val_nom, 85);
+		v_ctl_reg.val_max = fx_percent(v_ctl_reg.val_nom, 115);
 	} else {
 		v_ctl_reg.val_nom = 0;
 		v_ctl_reg.val_min = 0;
-		v_ctl_reg.val_max = 25;		// 0.1V
+		v_ctl_reg.val_max = 100;	// 0.1V
 	}
 
-	v_in.val_nom = (uint16_t)((V_IN / v_dd) * 1023.0);
-	v_in.val_min = (uint16_t)(((float)v_in.val_nom) * 0.8);
-	v_in.val_max = (uint16_t)(((float)v_in.val_nom) * 1.2);
+	v_in.val_nom = fx_counts(V_IN, v_ref_raw, V_REF);
+	v_in.val_min = fx_percent(v_in.val_nom, 80);
+	v_in.val_max = fx_percent(v_in.val_nom, 120);
 
 	// measure each voltage individually
 	v_hv.val = adc_read(ADC_V_HV);
@@ -249,20 +583,20 @@ void adc_factory_voltages_test(uint8_t boost, uint8_t *p)
 	if((v_in.val >= v_in.val_min) && (v_in.val <= v_in.val_max)) v_in.good = TRUE;
 	else v_in.good = FALSE;
 
-	if((v_dd < 5.0) && (v_dd > 4.0)) v_dd_good = TRUE;
+	if((v_dd < 5000) && (v_dd > 4000)) v_dd_good = TRUE;
 	else v_dd_good = FALSE;
 
 	// Report voltages through serial port
-	convert_and_send(v_hv.val, 42.2, V_HV, v_dd); 			// HIGH VOLTAGE (BOOST CONVERTER OUTPUT)
+	convert_and_send(v_hv.val, DIV_HV, V_HV, v_ref_raw); 		// HIGH VOLTAGE (BOOST CONVERTER OUTPUT)
 	if(v_hv.good) uart_send_string_p(PSTR(" - PASS"));
 	else uart_send_string_p(PSTR(" - FAIL!!!"));
-	convert_and_send(v_ctl_reg.val, 3.78, V_CTL_REG, v_dd);	// BOOST CONTROLLER INTERNAL REGULATOR
+	convert_and_send(v_ctl_reg.val, DIV_CTL_REG, V_CTL_REG, v_ref_raw);	// BOOST CONTROLLER INTERNAL REGULATOR
 	if(v_ctl_reg.good) uart_send_string_p(PSTR(" - PASS"));
 	else uart_send_string_p(PSTR(" - FAIL!!!"));
-	convert_and_send(v_in.val, 3.78, V_IN, v_dd);			// INPUT ADAPTER VOLTAGE
+	convert_and_send(v_in.val, DIV_IN, V_IN, v_ref_raw);		// INPUT ADAPTER VOLTAGE
 	if(v_in.good) uart_send_string_p(PSTR(" - PASS"));
 	else uart_send_string_p(PSTR(" - FAIL!!!"));
-	convert_and_send(1023, 1.0, V_DD, v_dd);				// CALCULATED VOLTAGE RAIL (4.3V ideallly)
+	convert_and_send(FX_ADC_TOP, DIV_NONE, V_DD, v_ref_raw);		// CALCULATED VOLTAGE RAIL (4.3V ideallly)
 	if(v_dd_good) uart_send_string_p(PSTR(" - PASS"));
 	else uart_send_string_p(PSTR(" - FAIL!!!"));
 
@@ -283,29 +617,46 @@ void adc_factory_voltages_test(uint8_t boost, uint8_t *p)
 -----------------------------------------------------------------------------*/
 
 /*===========================================================================*/
-static void convert_and_send(uint16_t v, float c, float what, float v_dd)
+static void convert_and_send(uint16_t v, uq6_10_t c, uint16_t what, uint16_t v_ref_raw)
 {
-	uint8_t integer, decimal;
-	char integer_str[5], decimal_str[5];
-	float fVoltage, float_part;
-
-	fVoltage = (float) v;
-	fVoltage = (fVoltage * v_dd * c) / 1023.0;	// "c" accounts for the resistor divider factor
-
-	integer = (uint8_t)fVoltage;			// Extract integer part
-	float_part = fVoltage - (float)integer;	// Extract floating part
-	decimal = (uint8_t)(float_part * 100.0);// two decimal digits
-
-	itoa(integer, integer_str, 10);			// convert integer part to string
-	itoa(decimal, decimal_str, 10);			// convert decimal part to string
-
-	if(what == V_HV)  uart_send_string_p(PSTR("\r\n- High Voltage: "));
-	else if(what == V_CTL_REG) uart_send_string_p(PSTR("\r\n- Boost controller regulator voltage: "));
-	else if(what == V_IN) uart_send_string_p(PSTR("\r\n- Input voltage: "));
-	else if(what == V_DD) uart_send_string_p(PSTR("\r\n- VDD rail voltage: "));
-	uart_send_string(integer_str);
-	uart_send_string_p(PSTR(","));
-	if(decimal < 10)						// significant digit correction
-		uart_send_string_p(PSTR("0"));
-	uart_send_string(decimal_str);
-}
\ No newline at end of file
+	const char *name;
+
+	if(what == V_HV) name = PSTR("High Voltage");
+	else if(what == V_CTL_REG) name = PSTR("Boost controller regulator voltage");
+	else if(what == V_IN) name = PSTR("Input voltage");
+	else name = PSTR("VDD rail voltage");
+	// "c" accounts for the resistor divider factor. mV to V, 2 decimals
+	uart_printf_P(PSTR("\r\n- %S: %.2lu"), name, fx_volts(v, v_ref_raw, V_REF, c) / 10);
+}
+
+/*===========================================================================*/
+/*
+* Starts the background sampler with empty rings. The supply monitor stays
+* disabled until adc_monitor() is called
+*/
+static void sampler_start(void)
+{
+	for(uint8_t i = 0; i < ADC_CH_N; i++){
+		for(uint8_t j = 0; j < ADC_RING_SIZE; j++)
+			ring[i][j] = 0;
+		sum[i] = 0;
+		ring_idx[i] = 0;
+	}
+	rounds = 0;
+	seq = 0;
+	monitor = FALSE;
+	faults = 0;
+	ADMUX = (ADMUX & ~(ADC_MUX_MASK)) | pgm_read_byte(&seq_mux[0]);
+	ADCSRA |= (1<<ADIF) | (1<<ADIE);	// clear flag, enable interrupts
+	sampler = TRUE;
+}
+
+/*===========================================================================*/
+static void sampler_stop(void)
+{
+	sampler = FALSE;
+	monitor = FALSE;
+	while(ADCSRA & (1<<ADSC));			// wait for an ongoing conversion
+	ADCSRA &= ~(1<<ADIE);
+	ADCSRA |= (1<<ADIF);				// clear flag
+}
@@ -25,13 +25,40 @@
 #define BOOST_ON 		TRUE
 #define BOOST_OFF		FALSE
 
+// Channels of the background sampler
+#define ADC_CH_HV		0		// high voltage (boost output)
+#define ADC_CH_CTL_REG	1		// boost controller regulator
+#define ADC_CH_IN		2		// input (adapter) voltage
+#define ADC_CH_REF		3		// internal reference (rail correction)
+#define ADC_CH_N		4
+
+// Supply monitor faults: one bit per channel
+#define ADC_FAULT_HV		(1<<ADC_CH_HV)
+#define ADC_FAULT_CTL_REG	(1<<ADC_CH_CTL_REG)
+#define ADC_FAULT_IN		(1<<ADC_CH_IN)
+#define ADC_FAULT_HV_TRIP	0x80	// high voltage fast shutdown
+
+// Longest wait for the high voltage to settle (ms)
+#define ADC_SETTLE_TIMEOUT	1000
+
 /******************************************************************************
 ******************** F U N C T I O N   P R O T O T Y P E S ********************
 ******************************************************************************/
 
 void adc_init(void);
 void adc_set(uint8_t state);
+void adc_clock(uint8_t speed);
 uint16_t adc_read(uint8_t adcx);
+void adc_tick(void);
+uint8_t adc_isr(void);
+uint8_t adc_ready(void);
+uint16_t adc_filtered(uint8_t ch);
+void adc_rails(uint16_t *cv);
+void adc_monitor(uint8_t state);
+uint8_t adc_faults(void);
+void adc_report_faults(void);
+uint16_t adc_trip_latency(void);
+uint16_t adc_hv_settle(void);
 uint8_t adc_voltages_test(void);
 uint8_t adc_factory_test_check(void);
 void adc_factory_voltages_test(uint8_t boost, uint8_t *p);
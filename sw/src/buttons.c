@@ -0,0 +1,307 @@
+/**
+ * @file buttons.c
+ * @brief Buttons debounce and event queue
+ *
+ * Buttons are sampled every 1ms from the general timer ISR. Debounced button
+ * actions are pushed as events into a small queue, consumed by the system
+ * states with buttons_get()
+ *
+ * @date 19.10.2026
+ *
+ */
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include "buttons.h"
+#include "buzzer.h"
+#include "config.h"
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Button pins (active low, all of them in PORTB)
+#define BTN_X_PIN		PINB7
+#define BTN_Y_PIN		PINB6
+#define BTN_Z_PIN		PINB5
+
+// Button time counts (in milliseconds)
+#define BTN_DTCT_TIME   7		// Integrator limit: time to assume a change
+#define BTN_DLY1_TIME	300		// click limit
+#define BTN_DLY3_TIME	2000	// long press and chord time
+#define BTN_BEEP_TIME	50		// duration of beep sound
+
+// Events queue size. Must be a power of 2
+#define BTN_QUEUE_SIZE	8
+#define BTN_QUEUE_MASK	(BTN_QUEUE_SIZE - 1)
+
+// Default auto-repeat: after 300ms, every 65ms
+static const repeat_s default_curve[] PROGMEM = {
+	{300, 65, 0}
+};
+
+// Curves used while setting the time and the alarm (hold time, period,
+// flag). Hours only speed up to 100ms (24 values). Minutes and seconds go
+// down to 25ms and then jump by tens, so any value is reached in a few
+// seconds
+static const repeat_s hours_curve[] PROGMEM = {
+	{300, 250, 0}, {1300, 100, 0}
+};
+static const repeat_s minutes_curve[] PROGMEM = {
+	{300, 250, 0}, {1300, 100, 0}, {2500, 25, 0}, {4000, 200, BTN_EV_FAST}
+};
+
+// Current gesture flags
+#define GST_HELD		0x01	// LONG or CHORD event sent
+#define GST_VOID		0x02	// gesture discarded by buttons_flush()
+
+/******************************************************************************
+*************** G L O B A L   V A R S   D E F I N I T I O N S *****************
+******************************************************************************/
+
+/*
+* Events queue: single producer (buttons_isr) and single consumer (system
+* states). Each index is written by only one side, and single byte accesses
+* are atomic, so no locking is required.
+*/
+static volatile uint8_t queue[BTN_QUEUE_SIZE];
+static volatile uint8_t q_head = 0;
+static volatile uint8_t q_tail = 0;
+
+// Debouncer state
+static volatile uint8_t enabled = FALSE;
+static volatile uint8_t stable = 0;		// debounced buttons state
+static volatile uint8_t gesture_flags = 0;
+static uint8_t integrator[3];
+static uint8_t gesture = 0;				// buttons pressed in current gesture
+static uint16_t press_time = 0;			// time since gesture started
+static uint16_t hold_time = 0;			// time since last buttons change
+static uint16_t next_repeat = 0;
+static const repeat_s *curve = default_curve;	// auto-repeat curve (FLASH)
+static uint8_t curve_n = 1;
+static uint8_t curve_step = 0;
+static uint8_t beep = 0;
+
+/******************************************************************************
+******************* F U N C T I O N   D E F I N I T I O N S *******************
+******************************************************************************/
+
+static void push(uint8_t ev);
+static uint8_t read_buttons(void);
+
+/*===========================================================================*/
+void buttons_init(void)
+{
+	integrator[0] = 0;
+	integrator[1] = 0;
+	integrator[2] = 0;
+	stable = 0;
+	gesture = 0;
+	gesture_flags = 0;
+	press_time = 0;
+	hold_time = 0;
+	beep = 0;
+	q_head = 0;
+	q_tail = 0;
+	enabled = TRUE;
+}
+
+/*===========================================================================*/
+/*
+* Enables or disables the buttons sampling (e.g. while sleeping). Any
+* debounce state and pending event is discarded.
+*/
+void buttons_set(uint8_t state)
+{
+	buttons_init();
+	enabled = state;
+}
+
+/*===========================================================================*/
+/*
+* Debounce routine. Executed every 1ms from the general timer ISR.
+* - PINB is sampled once for all three buttons
+* - Each button has an integrator: it counts up while the button reads
+*   pressed and down while released. The debounced state only changes when
+*   the integrator reaches one of its limits (0 or BTN_DTCT_TIME)
+* - A "gesture" starts when the first button is pressed and ends when all
+*   buttons are released. Its timing determines the events pushed into the
+*   queue
+*/
+void buttons_isr(void)
+{
+	uint8_t raw, prev, pressed, released, bit, i;
+
+	if(!enabled) return;
+
+	raw = read_buttons();
+	prev = stable;
+	for(i = 0, bit = BTN_X; i < 3; i++, bit <<= 1){
+		if(raw & bit){
+			if(integrator[i] < BTN_DTCT_TIME) integrator[i]++;
+			if(integrator[i] == BTN_DTCT_TIME) stable |= bit;
+		} else {
+			if(integrator[i] > 0) integrator[i]--;
+			if(integrator[i] == 0) stable &= ~bit;
+		}
+	}
+	pressed = stable & ~prev;
+	released = prev & ~stable;
+
+	// short beep on every button press
+	if(beep){
+		beep--;
+		if(!beep) buzzer_set(DISABLE);
+	}
+
+	if(pressed){
+		// new gesture
+		if(!prev){
+			gesture = 0;
+			gesture_flags = 0;
+			press_time = 0;
+			curve_step = 0;
+			next_repeat = pgm_read_word(&curve[0].hold);
+		}
+		gesture |= pressed;
+		hold_time = 0;
+		if(!(gesture_flags & GST_VOID)){
+			push(BTN_EV_PRESS | pressed);
+			buzzer_set(ENABLE);
+			beep = BTN_BEEP_TIME;
+		}
+	}
+	if(released) hold_time = 0;
+
+	if(stable){
+		if(press_time < 0xFFFF) press_time++;
+		if(hold_time < 0xFFFF) hold_time++;
+		if(gesture_flags & GST_VOID) return;
+
+		if(!(gesture & (gesture - 1))){
+			// single button gesture: auto-repeat and long press. The repeat
+			// period follows the curve step reached by the hold time
+			if((press_time >= next_repeat) && (press_time < 0xFF00)){
+				while((curve_step < (curve_n - 1)) && 
+					(press_time >= pgm_read_word(&curve[curve_step + 1].hold)))
+					curve_step++;
+				push(BTN_EV_REPEAT | pgm_read_byte(&curve[curve_step].flag) | stable);
+				next_repeat = press_time + pgm_read_byte(&curve[curve_step].interval);
+			}
+			if(press_time == BTN_DLY3_TIME){
+				push(BTN_EV_LONG | stable);
+				gesture_flags |= GST_HELD;
+			}
+		} else if((stable & (stable - 1)) && (hold_time == BTN_DLY3_TIME)){
+			// two or more buttons held together
+			if(!(gesture_flags & GST_HELD)){
+				push(BTN_EV_CHORD | stable);
+				gesture_flags |= GST_HELD;
+			}
+		}
+	} else if(released){
+		// end of gesture
+		if(!(gesture_flags & (GST_HELD | GST_VOID))){
+			if(press_time < BTN_DLY1_TIME) push(BTN_EV_RELEASE | BTN_EV_SHORT | gesture);
+			else push(BTN_EV_RELEASE | gesture);
+		}
+		gesture = 0;
+		gesture_flags = 0;
+	}
+}
+
+/*===========================================================================*/
+/*
+* Returns the oldest event in the queue, or BTN_EV_NONE if empty
+*/
+uint8_t buttons_get(void)
+{
+	uint8_t ev;
+
+	if(q_tail == q_head) return BTN_EV_NONE;
+	ev = queue[q_tail];
+	q_tail = (q_tail + 1) & BTN_QUEUE_MASK;
+	return ev;
+}
+
+/*===========================================================================*/
+/*
+* Debounced state of the buttons (BTN_X, BTN_Y, BTN_Z mask)
+*/
+uint8_t buttons_state(void)
+{
+	return stable;
+}
+
+/*===========================================================================*/
+/*
+* Discards all pending events. If a gesture is in progress, it is discarded
+* as well: no more events are generated until all buttons are released. Used
+* when entering a new system state, so it doesn't react to the button
+* actions meant for the previous one.
+*/
+void buttons_flush(void)
+{
+	q_tail = q_head;
+	if(stable) gesture_flags |= GST_VOID;
+	buttons_repeat(default_curve, sizeof(default_curve)/sizeof(repeat_s));
+}
+
+/*===========================================================================*/
+/*
+* Selects the auto-repeat curve (array of n steps, stored in FLASH). The
+* default curve is restored by buttons_flush(), so each state that needs a
+* different one selects it after flushing. If a button is being held, the
+* curve applies from its next repeat event.
+*/
+void buttons_repeat(const repeat_s *c, uint8_t n)
+{
+	curve = c;
+	curve_n = n;
+	curve_step = 0;
+}
+
+/*===========================================================================*/
+/*
+* Selects the auto-repeat curve for setting a time, according to the
+* quantity being set (hours, or minutes and seconds)
+*/
+void buttons_repeat_time(uint8_t hours)
+{
+	if(hours) buttons_repeat(hours_curve, sizeof(hours_curve)/sizeof(repeat_s));
+	else buttons_repeat(minutes_curve, sizeof(minutes_curve)/sizeof(repeat_s));
+}
+
+/*-----------------------------------------------------------------------------
+-------------------------- L O C A L   F U N C T I O N S ----------------------
+-----------------------------------------------------------------------------*/
+
+/*===========================================================================*/
+static void push(uint8_t ev)
+{
+	uint8_t next = (q_head + 1) & BTN_QUEUE_MASK;
+
+	// if the queue is full, the event is lost
+	if(next != q_tail){
+		queue[q_head] = ev;
+		q_head = next;
+	}
+}
+
+/*===========================================================================*/
+static uint8_t read_buttons(void)
+{
+	uint8_t pins = ~PINB;	// single read; pressed buttons read as 1
+	uint8_t b = 0;
+
+	if(pins & (1<<BTN_X_PIN)) b |= BTN_X;
+	if(pins & (1<<BTN_Y_PIN)) b |= BTN_Y;
+	if(pins & (1<<BTN_Z_PIN)) b |= BTN_Z;
+	return b;
+}
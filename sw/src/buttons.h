@@ -0,0 +1,81 @@
+/**
+ * @file buttons.h
+ * @brief Buttons debounce and event queue
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#ifndef BUTTONS_H
+#define BUTTONS_H
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include <stdint.h>
+
+/******************************************************************************
+***************** S T R U C T U R E   D E C L A R A T I O N S *****************
+******************************************************************************/
+
+/*
+* Auto-repeat curve step: once a button has been held for "hold" ms, REPEAT
+* events are sent every "interval" ms, carrying "flag". Curves are arrays of
+* steps sorted by hold time, stored in FLASH.
+*/
+typedef struct {
+	uint16_t hold;			// hold time to start this step (ms)
+	uint8_t interval;		// repeat period (ms)
+	uint8_t flag;			// event flag: 0 or BTN_EV_FAST
+} repeat_s;
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Buttons mask bits
+#define BTN_X			0x01
+#define BTN_Y			0x02
+#define BTN_Z			0x04
+#define BTN_XYZ			(BTN_X | BTN_Y | BTN_Z)
+
+/*
+* Button events. One byte per event:
+* - bits 7..4: event type
+* - bit 3: event flag (meaning depends on the event type)
+* - bits 2..0: buttons involved (BTN_X, BTN_Y, BTN_Z)
+*/
+#define BTN_EV_NONE		0x00
+#define BTN_EV_PRESS	0x10	// a button was pressed (one event per button)
+#define BTN_EV_RELEASE	0x20	// all buttons released; no LONG/CHORD was sent
+#define BTN_EV_LONG		0x30	// single button held for BTN_DLY3_TIME
+#define BTN_EV_REPEAT	0x40	// single button held: auto-repeat
+#define BTN_EV_CHORD	0x50	// several buttons held together for BTN_DLY3_TIME
+
+// RELEASE flag: buttons were held less than BTN_DLY1_TIME (a "click")
+#define BTN_EV_SHORT	0x08
+// REPEAT flag: the repeat curve requests a coarse step (e.g. tens jumps)
+#define BTN_EV_FAST		0x08
+
+#define BTN_EV_TYPE(e)	((e) & 0xF0)
+#define BTN_EV_BTNS(e)	((e) & BTN_XYZ)
+
+// Short press and release of a single button
+#define BTN_CLICK(b)	(BTN_EV_RELEASE | BTN_EV_SHORT | (b))
+
+/******************************************************************************
+******************** F U N C T I O N   P R O T O T Y P E S ********************
+******************************************************************************/
+
+void buttons_init(void);
+void buttons_set(uint8_t state);
+void buttons_isr(void);
+
+uint8_t buttons_get(void);
+uint8_t buttons_state(void);
+void buttons_flush(void);
+void buttons_repeat(const repeat_s *c, uint8_t n);
+void buttons_repeat_time(uint8_t hours);
+
+#endif	/* BUTTONS_H */
@@ -14,6 +14,7 @@
 ******************************************************************************/
 
 #include "buzzer.h"
+#include "clock.h"
 #include "config.h"
 #include "timers.h"
 #include "uart.h"
@@ -21,7 +22,7 @@
 #include <avr/pgmspace.h>
 #include <util/delay.h>
 #include <stdint.h>
-#include <stdlib.h>
+#include <stddef.h>
 
 /******************************************************************************
 ******************* C O N S T A N T   D E F I N I T I O N S *******************
@@ -368,6 +369,23 @@ static const note_s usa_anthem[] PROGMEM = {
 	{N_G7, QUARTER_NOTE},	
 };
 
+/*
+* Note durations of the melody being played. Statically allocated for the
+* longest melody (super_mario_theme), instead of taken from the heap on every
+* alarm: the RAM usage is known at link time (see ram.c)
+*/
+#define NOTES(t)		(sizeof(t) / sizeof(note_s))
+#define MAX_OF(a, b)	(((a) > (b)) ? (a) : (b))
+#define POOL_NOTES		MAX_OF(MAX_OF(MAX_OF(NOTES(star_wars_theme), \
+						NOTES(imperial_march_theme)), \
+						MAX_OF(NOTES(major_scale), NOTES(super_mario_theme))), \
+						MAX_OF(MAX_OF(NOTES(simple_alarm), NOTES(diomedes)), \
+						NOTES(usa_anthem)))
+
+static uint16_t duration_pool[POOL_NOTES];
+// Most notes used from the pool since the last reset
+static uint8_t pool_peak = 0;
+
 /******************************************************************************
 ******************* F U N C T I O N   D E F I N I T I O N S *******************
 ******************************************************************************/
@@ -384,6 +402,8 @@ static size_t theme_size(uint8_t theme);
 */
 void buzzer_beep(void)
 {
+	// _delay_ms() needs the F_CPU clock
+	clock_set(CLK_SLOW);
 	timer_buzzer_set(ENABLE, N_C8);
 	_delay_ms(30);
 	timer_buzzer_set(DISABLE, N_C8);
@@ -416,7 +436,7 @@ uint8_t buzzer_music(uint8_t theme, uint8_t state)
 	//static uint16_t count_vect[100];
 	static size_t size;
 	static const note_s *theme_p = NULL;
-	static uint16_t *duration_p = NULL; 
+	uint16_t *duration_p = duration_pool;
 	
 	/* 
 	* Different melodies have different tempo. Thus, the time duration of each
@@ -435,8 +455,7 @@ uint8_t buzzer_music(uint8_t theme, uint8_t state)
 			tempo = theme_tempo(theme);
 			size = theme_size(theme);
 			theme_p = theme_pointer(theme);
-			
-			duration_p = (uint16_t *)calloc(size, sizeof(uint16_t));
+			if(size > pool_peak) pool_peak = size;
 			
 			// calculate proper notes' duration and store the result in vector
 			for(uint8_t i = 0; i < size; i++)
@@ -456,9 +475,7 @@ uint8_t buzzer_music(uint8_t theme, uint8_t state)
 		// If melody finishes playing, output TRUE
 		if(n >= size){
 			timer_buzzer_set(DISABLE, N_C8);
-			free((void *)duration_p);
 			theme_p = NULL;
-			duration_p = NULL;
 			intro = TRUE;
 			out = TRUE;
 		}
@@ -468,15 +485,27 @@ uint8_t buzzer_music(uint8_t theme, uint8_t state)
 		// If "state" flag is disabled, stop playing melody and disable buzzer
 		intro = TRUE;
 		timer_buzzer_set(DISABLE, N_SIL);	
-		if(duration_p != NULL){
-			free((void *)duration_p);
-			duration_p = NULL;
-		}
 	}	
 	
 	return out;
 }
 
+/*===========================================================================*/
+/*
+* Size of the note durations pool, and the most of it used since the last
+* reset, in bytes
+*/
+uint16_t buzzer_pool_size(void)
+{
+	return sizeof(duration_pool);
+}
+
+/*===========================================================================*/
+uint16_t buzzer_pool_peak(void)
+{
+	return pool_peak * sizeof(uint16_t);
+}
+
 /*-----------------------------------------------------------------------------
 -------------------------- L O C A L   F U N C T I O N S ----------------------
 -----------------------------------------------------------------------------*/
@@ -538,9 +567,5 @@ static size_t theme_size(uint8_t theme)
 */
 static uint16_t note_duration(uint16_t counts, uint8_t tempo)
 {
-	float f_tempo = (float) tempo;
-	float f_counts = (float) counts;
-	float x = (100.0 / f_tempo) * f_counts;
-
-	return (uint16_t) x;
+	return (uint16_t)(((uint32_t)counts * 100) / tempo);
 }
\ No newline at end of file
@@ -38,5 +38,7 @@
 void buzzer_beep(void);
 void buzzer_set(uint8_t state);
 uint8_t buzzer_music(uint8_t theme, uint8_t state);
+uint16_t buzzer_pool_size(void);
+uint16_t buzzer_pool_peak(void);
 
 #endif /* BUZZER_H */
\ No newline at end of file
@@ -0,0 +1,189 @@
+/**
+ * @file clock.c
+ * @brief CPU clock scaling
+ *
+ * The firmware is built for F_CPU (16MHz resonator divided by 8 by the
+ * CKDIV8 fuse). clock_set() changes the system clock prescaler at run time,
+ * so heavy animations can run at 16MHz. Every peripheral clocked from the
+ * system clock is retimed, so its timing doesn't change: the general timer
+ * keeps its 4us tick, the buzzer notes keep their pitch, the UART its baud
+ * rate and the ADC its 125KHz clock. The LEDs PWM duty cycle doesn't depend
+ * on the clock, so those timers are left alone.
+ *
+ * _delay_ms() and _delay_us() are computed for F_CPU: functions using them
+ * switch back to the slow clock first. Loops that run while the UART may be
+ * sending use clock_request() instead.
+ *
+ * 16MHz is only within the speed grade above about 3.8V, and the brown-out
+ * detector is set much lower (1.8V). When the adapter is removed, the power
+ * loss ISR drops to 2MHz with clock_power_loss() before it writes the time
+ * journal, while VCC sags: right away, without waiting for the UART.
+ *
+ * @date 19.10.2026
+ *
+ */
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include "clock.h"
+#include "adc.h"
+#include "config.h"
+#include "timers.h"
+#include "uart.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// System clock prescaler settings
+#define CLK_DIV8		((1<<CLKPS1) | (1<<CLKPS0))
+#define CLK_DIV1		0
+
+// General timer ticks per ms (see timer_base_init)
+#define CLK_LOOP_TICKS	250
+
+/******************************************************************************
+*************** G L O B A L   V A R S   D E F I N I T I O N S *****************
+******************************************************************************/
+
+static uint8_t speed_now = CLK_SLOW;
+
+/*
+* Loop load statistics, per clock speed: busy time of the 1ms loops (in
+* general timer ticks) and the loops that took longer than 1ms (the
+* animation slows down)
+*/
+static uint32_t busy_sum[CLK_N];
+static uint16_t loops[CLK_N];
+static uint16_t overruns[CLK_N];
+static uint8_t busy_max[CLK_N];
+
+/******************************************************************************
+******************* F U N C T I O N   D E F I N I T I O N S *******************
+******************************************************************************/
+
+/*===========================================================================*/
+/*
+* Switches the CPU clock and retimes the peripherals. Pending UART
+* transmissions and ADC conversions are completed first.
+*/
+void clock_set(uint8_t speed)
+{
+	uint8_t sreg = SREG;
+
+	if(speed == speed_now) return;
+
+	cli();
+	uart_clock(speed);
+	adc_clock(speed);
+	// timed sequence: CLKPR must be written within 4 cycles of CLKPCE
+	CLKPR = (1<<CLKPCE);
+	CLKPR = (speed == CLK_FAST) ? CLK_DIV1 : CLK_DIV8;
+	timer_clock(speed);
+	speed_now = speed;
+	SREG = sreg;
+}
+
+/*===========================================================================*/
+/*
+* Non-blocking clock_set(), for the loops that request a speed every ms. The
+* switch is deferred while the UART is sending: clock_set() would wait for
+* it with interrupts disabled (up to the whole transmit ring, 33ms at
+* 19200 baud), stalling the tubes multiplexing. The ring keeps draining
+* between loops, and the switch happens in the first loop it's idle.
+*/
+void clock_request(uint8_t speed)
+{
+	if((speed != speed_now) && uart_tx_idle()) clock_set(speed);
+}
+
+/*===========================================================================*/
+/*
+* Back to the slow clock at once, from the external power ISR. Unlike
+* clock_set(), the UART isn't drained (a char being sent is garbled): the
+* system is going to sleep, and VCC is already dropping. The ADC clock is
+* retimed last, as it waits for an ongoing conversion
+*/
+void clock_power_loss(void)
+{
+	if(speed_now == CLK_SLOW) return;
+
+	// timed sequence: CLKPR must be written within 4 cycles of CLKPCE
+	CLKPR = (1<<CLKPCE);
+	CLKPR = CLK_DIV8;
+	speed_now = CLK_SLOW;
+	timer_clock(CLK_SLOW);
+	uart_baud(CLK_SLOW);
+	adc_clock(CLK_SLOW);
+}
+
+/*===========================================================================*/
+uint8_t clock_get(void)
+{
+	return speed_now;
+}
+
+/*===========================================================================*/
+/*
+* Logs the load of the current loop. Called by a system state right before
+* it waits for the next ms: the general timer count is the time it was busy
+* since the last tick. A compare match still pending means it took over 1ms
+*/
+void clock_load(void)
+{
+	uint8_t t = (uint8_t)TCNT3;
+
+	if(loops[speed_now] == 0xFFFF) return;
+	loops[speed_now]++;
+	if(TIFR3 & (1<<OCF3A)){
+		overruns[speed_now]++;
+		t = CLK_LOOP_TICKS;
+	}
+	busy_sum[speed_now] += t;
+	if(t > busy_max[speed_now]) busy_max[speed_now] = t;
+}
+
+/*===========================================================================*/
+/*
+* Load statistics of a clock speed, without clearing them: average and
+* maximum busy time (%) and loops that took longer than 1ms
+*/
+void clock_stats(uint8_t speed, uint8_t *avg, uint8_t *max, uint16_t *over)
+{
+	if(loops[speed]) *avg = (uint8_t)((busy_sum[speed] * 100) / ((uint32_t)loops[speed] * CLK_LOOP_TICKS));
+	else *avg = 0;
+	*max = (uint8_t)(((uint16_t)busy_max[speed] * 100) / CLK_LOOP_TICKS);
+	*over = overruns[speed];
+}
+
+/*===========================================================================*/
+/*
+* Sends the load statistics of each clock speed through the serial port,
+* and clears them. The loops busy wait for the next ms, so the core energy
+* is proportional to the clock: 8 times higher at 16MHz. The load and
+* overruns tell how smooth the animations are at each speed.
+*/
+void clock_report(void)
+{
+	for(uint8_t i = 0; i < CLK_N; i++){
+		if(i == CLK_SLOW) uart_send_string_p(PSTR("\n\rLOAD 2MHz (core energy x1)"));
+		else uart_send_string_p(PSTR("\n\rLOAD 16MHz (core energy x8)"));
+		uart_printf_P(PSTR("\n\r - loops: %u"), loops[i]);
+		if(loops[i]){
+			uart_printf_P(PSTR("\n\r - average (%%): %u\n\r - max (%%): %u\n\r - over 1ms: %u"),
+				(uint16_t)((busy_sum[i] * 100) / ((uint32_t)loops[i] * CLK_LOOP_TICKS)),
+				((uint16_t)busy_max[i] * 100) / CLK_LOOP_TICKS, overruns[i]);
+		}
+		busy_sum[i] = 0;
+		loops[i] = 0;
+		overruns[i] = 0;
+		busy_max[i] = 0;
+	}
+}
@@ -0,0 +1,39 @@
+/**
+ * @file clock.h
+ * @brief CPU clock scaling
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include <stdint.h>
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// CPU clock speeds: 16MHz resonator divided by 8 (F_CPU) or not divided
+#define CLK_SLOW		0
+#define CLK_FAST		1
+#define CLK_N			2
+
+/******************************************************************************
+******************** F U N C T I O N   P R O T O T Y P E S ********************
+******************************************************************************/
+
+void clock_set(uint8_t speed);
+void clock_request(uint8_t speed);
+void clock_power_loss(void);
+uint8_t clock_get(void);
+void clock_load(void);
+void clock_report(void);
+void clock_stats(uint8_t speed, uint8_t *avg, uint8_t *max, uint16_t *over);
+
+#endif	/* CLOCK_H */
@@ -27,10 +27,34 @@
 
 // 16MHz ceramic resonator, prescaled by 8
 #define F_CPU			2000000UL
-// A non-usual baud rate, but it's needed due to the low operating frequency,
-// so that it may work with no errors
-//#define BAUD 			125000UL
+/*
+* Serial port. 19200 baud works with any USB-serial adapter. 125000 baud is
+* exact at 2MHz and 16MHz, for the binary telemetry and the remote display
+* streaming, with an adapter that supports it: "make build BAUD=125000".
+* The baud rate error is checked at build time (uart.c)
+*/
+#ifndef BAUD
 #define BAUD 			19200UL
+#endif
+// Double speed mode: half the UART clock divider. Needed for 19200 baud
+#define UART_U2X		TRUE
+/*
+* Bootloader (boot/bootloader.c): start of the boot section (byte address,
+* BOOTSZ fuses in main.c), and the GPIOR0 value that requests a firmware
+* update when the application jumps into it
+*/
+#define BOOT_START		0x7000
+#define BOOT_MAGIC		0xB7
+// Reset flags handed over by the bootloader in GPIOR1 along with MCUSR, in
+// the unused bits: watchdog resets it does on purpose (WDRF is left out)
+#define BOOT_RESET_UPDATE	0x80	// new firmware written
+#define BOOT_RESET_IDLE		0x40	// "update" command, but the host was silent
+
+// Boot profile: FAST_BOOT skips the onboard LED blink and the intro animation
+//#define FAST_BOOT
+
+// Serial output: TELEMETRY_BINARY sends binary frames instead of text lines
+//#define TELEMETRY_BINARY
 
 // GENERIC BOOLEAN MACROS
 #define TRUE		0x01
@@ -77,11 +101,6 @@
 #define PERIOD_AM		0xAA
 #define PERIOD_PM		0xFF
 
-// BUTTON STATE MACROS
-#define BTN_IDLE		0xEE
-#define BTN_PUSHED		0xDD
-#define BTN_RELEASED	0xAA
-
 // Flag: Increment Hr/min/secs count
 #define INC_HOUR		0x12
 #define INC_MIN			0x13
@@ -106,6 +125,7 @@ typedef enum {
 	ALARM_TRIGGERED,
 	SET_TRANSITIONS,
 	SET_ALARM_THEME,
+	REMOTE_DISPLAY,
 	USR_TEST,
 	PRODUCTION_TEST,
 	SYSTEM_RESET
@@ -115,7 +135,7 @@ typedef enum {
 ******************** E X T E R N A L   V A R I A B L E S **********************
 ******************************************************************************/
 
-extern uint8_t system_reset;
+extern volatile uint8_t system_reset;
 extern volatile uint8_t loop;
 
 #endif	/* CONFIG_H */
\ No newline at end of file
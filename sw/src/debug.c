@@ -15,19 +15,21 @@
 
 #include "debug.h"
 #include "adc.h"
+#include "buttons.h"
 #include "buzzer.h"
 #include "config.h"
 #include "eeprom.h"
 #include "external_interrupt.h"
+#include "leds.h"
 #include "menu_time.h"
 #include "timers.h"
 #include "uart.h"
 #include "util.h"
+#include "watchdog.h"
 
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 #include <stdint.h>
-#include <stdlib.h>
 #include <util/delay.h>
 
 /******************************************************************************
@@ -35,6 +37,8 @@
 ******************************************************************************/
 
 static void print_rom_report(void);
+static void set_rtc_calibration(void);
+static const char *pass_fail(uint8_t result);
 
 /*===========================================================================*/
 /*
@@ -42,70 +46,25 @@ static void print_rom_report(void);
 * by holding the X button pressed at the end of the "Intro" animation. Here,
 * the user can inspect:
 * - Whether all tubes' digits light up
-* - the asyunchronous timer peripheral is working (otherwise, the LEDs sync
-* signal would not work, and the LEDs breathing effect would remain static)
+* - the asyunchronous timer peripheral is working (otherwise, the LEDs color
+* would not change: the LEDs animator only switches colors on RTC ticks)
 * - All RGB LED colors are working
 * - The buzzer sounds properly
 */
 void usr_test(volatile state_t *state)
 {
+	uint8_t ev;
 	uint16_t count = 0;
 	uint8_t n = 0;
-	// leds related quantities
-	uint8_t leds_cnt_up = TRUE;
-	uint16_t leds_count = 0;
-	uint8_t leds_color = 0;
+
+	leds_animate(LEDS_CYCLE);
+	buttons_flush();
 
 	/*
 	* INFINITE LOOP
 	*/
 	while(TRUE){
 
-		/*
-		* LEDs SEQUENCES
-		* - breathing sequence: leds are synced to the RTC by means of the 
-		*   time.update flag.
-		*/
-		if(leds_cnt_up){
-			if(leds_count < 995) leds_count++;
-			else leds_count = 995;
-		} else {
-			if(leds_count > 5) leds_count--;
-			else leds_count = 5;
-		}
-		// sync leds_count with the general counter (T = 1ms)
-		if(time.update){
-			time.update = FALSE;
-			if((leds_cnt_up) && (leds_count > 500)){
-				leds_cnt_up = FALSE;
-				leds_count = 995;
-			} else if((!leds_cnt_up) && (leds_count < 500)){
-				leds_cnt_up = TRUE;
-				leds_count 
-				= 5;
-				leds_color++;
-				if(leds_color >= 3) leds_color = 0;
-			}
-		}
-		// LEDs update value every 5ms, not every ms (LEDs value does not change every ms)
-		if(!(leds_count % 5)){
-			uint8_t led_r = 0, led_g = 0, led_b = 0;
-			if(leds_color == 0){
-				led_r = (uint8_t)(leds_count>>4);
-				led_g = 0;
-				led_b = 0;
-			} else if(leds_color == 1){
-				led_r = 0;
-				led_g = (uint8_t)(leds_count>>4);
-				led_b = 0;
-			} else if(leds_color == 2){
-				led_r = 0;
-				led_g = 0;
-				led_b = (uint8_t)(leds_count>>4);;
-			}
-			timer_leds_set(ENABLE, led_r, led_g, led_b);
-		}
-
 		/*
 		* DISPLAY transition
 		*/
@@ -115,22 +74,16 @@ void usr_test(volatile state_t *state)
 		display.d4 = n;	
 		
 		/* 
-		* BUTTONS check: Buttons are detected using an ISR which sets btnXYZ
-	    * flags. Once set, the rest of the detection and debounce routine is
-	    * handled within buttons_check(), based on the 1ms execution period of
-	    * the main infinite loop
-	    *
-	    * BUTTONS actions:
+		* BUTTONS events: Buttons are sampled and debounced by the 1ms timer
+		* ISR, which queues the button events (see buttons.c). One event is
+		* consumed per loop execution.
+		*
+		* BUTTONS actions:
 		* - If any of the buttons is pressed, jump to SYSTEM_INTRO
 		*/
-		if(btnX.query) buttons_check(&btnX);
-	    if(btnY.query) buttons_check(&btnY);
-	    if(btnZ.query) buttons_check(&btnZ);
+		ev = buttons_get();
 		
-		if((btnX.action) || (btnY.action) || (btnZ.action)){
-			btnX.action = FALSE;
-			btnY.action = FALSE;
-			btnZ.action = FALSE;
+		if(BTN_EV_TYPE(ev) == BTN_EV_PRESS){
 			*state = SYSTEM_INTRO;
 		}
 
@@ -164,6 +117,8 @@ void usr_test(volatile state_t *state)
 			break;
 
 	}	/* INFINITE LOOP */
+
+	leds_animate(LEDS_MANUAL);
 }
 
 /*===========================================================================*/
@@ -214,6 +169,7 @@ void production_test(volatile state_t *state)
 	_delay_ms(1);
 	while(!uart_check_rx()){
 		led_blink(1, 20);
+		watchdog_feed();
 	}
 	// wait for any voltage transient to stop
 	uart_set(ENABLE);
@@ -242,6 +198,7 @@ void production_test(volatile state_t *state)
 	// "hidden" commands:
 	// if '.' is pressed three times, print the whole test report saved in ROM.
 	// if 'q' is pressed, quit this test 
+	// if 'c' is pressed, set the RTC drift calibration
 	if(c == '.'){
 		c = uart_read_char();
 		if(c == '.'){
@@ -260,6 +217,10 @@ void production_test(volatile state_t *state)
 		// quit factory test
 		*state = SYSTEM_INTRO;
 		return;
+	} else if(c == 'c'){
+		set_rtc_calibration();
+		*state = SYSTEM_INTRO;
+		return;
 	}
 
 	/*************************************************************************/
@@ -269,21 +230,20 @@ void production_test(volatile state_t *state)
 
 	// Perform the voltages test 3 times.
 	for(uint8_t i = 0; i < 3; i++){
-		uart_send_string_p(PSTR("\n\rcheck #"));
-		char str[3];
-		itoa(i+1, str, 10);
-		uart_send_string(str);
+		uart_printf_P(PSTR("\n\rcheck #%u"), i + 1);
 		BOOST_SET(DISABLE);
 		uart_send_string_p(PSTR("\n\rboost converter DISABLED"));
+		uart_tx_flush();
 		// Wait for the output cap to discharge. It takes 4 seconds to discharge
-		_delay_ms(4000);
+		watchdog_delay_ms(4000);
 		// perform the 4 voltages' tests and store all 4 results in the first
 		// 4 positions of the given vector
 		adc_factory_voltages_test(BOOST_OFF, p[i]);
 		BOOST_SET(ENABLE);
 		uart_send_string_p(PSTR("\n\rboost converter ENABLED"));
+		uart_tx_flush();
 		// wait for the output cap to charge back up. Takes only less than 200ms
-		_delay_ms(2000);
+		watchdog_delay_ms(2000);
 		// perform the 4 voltages' tests and store all 4 results in the second
 		// 4 positions of the given vector
 		adc_factory_voltages_test(BOOST_ON, p[i] + 4);
@@ -313,6 +273,7 @@ void production_test(volatile state_t *state)
  	// may be halted.
  	while(!time.update){
  		_delay_us(100);
+ 		watchdog_feed();
  		x++;
  		if(x > 30000){ 		// 3 seconds elapsed
  			clock_ok = FALSE;
@@ -331,17 +292,15 @@ void production_test(volatile state_t *state)
 		 	while(!time.update);
 		 	time.update = FALSE;
 		 	loop = FALSE;
-		 	while(!time.update){
+		 	// this loop feeds the watchdog: stop if the RTC second never comes
+		 	while(!time.update && (cnt < 2000)){
 		 		while(!loop);
 		 		loop = FALSE;
 		 		cnt++;
 		 	}
 		 	times[x] = cnt;
 		 	x++;
-		 	uart_send_string_p(PSTR("\n\r ms per RTC second: "));
-		 	char str[5];
-		 	itoa(cnt, str, 10);
-		 	uart_send_string(str);
+		 	uart_printf_P(PSTR("\n\r ms per RTC second: %u"), cnt);
 		 	// Accepted range: [990ms, 1010ms]
 		 	if((cnt >= 990) && (cnt <= 1010)){
 		 		uart_send_string_p(PSTR(" - PASS"));
@@ -464,11 +423,7 @@ void production_test(volatile state_t *state)
 	/*************************************************************************/
 	// Increase the counter in ROM that contains the No of tests performed
 	x = (uint16_t)rom_increase_test_cnt();
-	char str[3];
-	itoa(x, str, 10);
-	uart_send_string_p(PSTR("\n\r ### Tests Count: "));
-	uart_send_string(str);
-	uart_send_string_p(PSTR("\n\r << TEST FINISHED >>\n\r"));
+	uart_printf_P(PSTR("\n\r ### Tests Count: %u\n\r << TEST FINISHED >>\n\r"), x);
 	
 	uart_send_string_p(PSTR("                     __gggrgM**M#mggg__\r\n"));
 	uart_send_string_p(PSTR("                __wgNN@*B*P**mp**@d#*@N#Nw__\r\n"));
@@ -507,97 +462,93 @@ static void print_rom_report(void)
 
 	// Print No of tests performed 'til now
 	x = (uint16_t)rom_query_test_cnt();
-	uart_send_string_p(PSTR("No of Tests Performed: "));
-	char str[6];
-	itoa(x, str, 10);
-	uart_send_string(str);
+	uart_printf_P(PSTR("No of Tests Performed: %u"), x);
 
-	// Print an array of all (24) voltage tests performed
+	// Print an array of all (24) voltage tests performed: 3 tests, with the
+	// boost disabled and enabled
 	uint8_t v[24];
 	rom_query_voltages_test(v);
 	uart_send_string_p(PSTR("\n\r [ 1 ] SYSTEM VOLTAGES"));
-	uart_send_string_p(PSTR("\n\r test No 1"));
-	uart_send_string_p(PSTR("\n\r > Boost DISABLED:"));
-	uart_send_string_p(PSTR("\n\r - V_hv      | V_ctl_reg | V_in      | V_dd\n\r   "));
-	for(uint8_t i = 0; i < 4; i++){
-		if(v[i] == PASS) uart_send_string_p(PSTR("PASS        "));
-		else uart_send_string_p(PSTR("FAIL        "));
-	}
-	uart_send_string_p(PSTR("\n\r > Boost DISABLED:"));
-	uart_send_string_p(PSTR("\n\r - V_hv      | V_ctl_reg | V_in      | V_dd\n\r   "));
-	for(uint8_t i = 4; i < 8; i++){
-		if(v[i] == PASS) uart_send_string_p(PSTR("PASS        "));
-		else uart_send_string_p(PSTR("FAIL        "));
-	}
-
-	uart_send_string_p(PSTR("\n\r test No 2"));
-	uart_send_string_p(PSTR("\n\r > Boost DISABLED:"));
-	uart_send_string_p(PSTR("\n\r - V_hv      | V_ctl_reg | V_in      | V_dd\n\r   "));
-	for(uint8_t i = 8; i < 12; i++){
-		if(v[i] == PASS) uart_send_string_p(PSTR("PASS        "));
-		else uart_send_string_p(PSTR("FAIL        "));
-	}
-	uart_send_string_p(PSTR("\n\r > Boost DISABLED:"));
-	uart_send_string_p(PSTR("\n\r - V_hv      | V_ctl_reg | V_in      | V_dd\n\r   "));
-	for(uint8_t i = 12; i < 16; i++){
-		if(v[i] == PASS) uart_send_string_p(PSTR("PASS        "));
-		else uart_send_string_p(PSTR("FAIL        "));
-	}
-
-	uart_send_string_p(PSTR("\n\r test No 3"));
-	uart_send_string_p(PSTR("\n\r > Boost DISABLED:"));
-	uart_send_string_p(PSTR("\n\r - V_hv      | V_ctl_reg | V_in      | V_dd\n\r   "));
-	for(uint8_t i = 16; i < 20; i++){
-		if(v[i] == PASS) uart_send_string_p(PSTR("PASS        "));
-		else uart_send_string_p(PSTR("FAIL        "));
-	}
-	uart_send_string_p(PSTR("\n\r > Boost DISABLED:"));
-	uart_send_string_p(PSTR("\n\r - V_hv      | V_ctl_reg | V_in      | V_dd\n\r   "));
-	for(uint8_t i = 20; i < 24; i++){
-		if(v[i] == PASS) uart_send_string_p(PSTR("PASS        "));
-		else uart_send_string_p(PSTR("FAIL        "));
+	for(uint8_t i = 0; i < 24; i++){
+		if(!(i % 8)) uart_printf_P(PSTR("\n\r test No %u"), (i / 8) + 1);
+		if(!(i % 4)){
+			uart_printf_P(PSTR("\n\r > Boost %S:\n\r - V_hv      | V_ctl_reg | V_in      | V_dd\n\r   "),
+				(i & 4) ? PSTR("ENABLED") : PSTR("DISABLED"));
+		}
+		uart_printf_P(PSTR("%-12S"), pass_fail(v[i]));
 	}
 
 	// Print List of Times registered during the RTC test
 	uint16_t t[3];
 	x = rom_query_rtc_ok_test();
 	rom_query_rtc_time_test(t);
-	uart_send_string_p(PSTR("\n\r\n\r [ 2 ] TIMING & CRYSTALS"));
-	uart_send_string_p(PSTR("\n\rClock Timer: "));
-	if(x == PASS) uart_send_string_p(PSTR("PASS"));
-	else uart_send_string_p(PSTR("FAIL"));
-	uart_send_string_p(PSTR("\n\r1 Hz times:"));
-	for(uint8_t i = 0; i < 3; i++){
-		itoa(t[i], str, 10);
-		uart_send_string_p(PSTR("\n\r > "));
-		uart_send_string(str);
-	}
+	uart_printf_P(PSTR("\n\r\n\r [ 2 ] TIMING & CRYSTALS\n\rClock Timer: %S\n\r1 Hz times:"),
+		pass_fail(x));
+	for(uint8_t i = 0; i < 3; i++) uart_printf_P(PSTR("\n\r > %u"), t[i]);
 
 	// Print Buzer result during test
 	x = rom_query_buzzer_ok_test();
-	uart_send_string_p(PSTR("\n\r\n\r [ 3 ] BUZZER & MUSIC"));
-	uart_send_string_p(PSTR("\n\rBuzzer test: "));
-	if(x == PASS) uart_send_string_p(PSTR("PASS"));
-	else uart_send_string_p(PSTR("FAIL"));
+	uart_printf_P(PSTR("\n\r\n\r [ 3 ] BUZZER & MUSIC\n\rBuzzer test: %S"), pass_fail(x));
 
 	// Print LEDs result during test
 	uint8_t l[4];
 	rom_query_leds_test(l);
-	uart_send_string_p(PSTR("\n\r\n\r [ 4 ] LEDs COLORS & BRIGHTNESS"));
-	uart_send_string_p(PSTR("\n\rRED: "));
-	if(l[0] == PASS) uart_send_string_p(PSTR("PASS"));
-	else uart_send_string_p(PSTR("FAIL"));
-	uart_send_string_p(PSTR("\n\rGREEN: "));
-	if(l[1] == PASS) uart_send_string_p(PSTR("PASS"));
-	else uart_send_string_p(PSTR("FAIL"));
-	uart_send_string_p(PSTR("\n\rBLUE: "));
-	if(l[2] == PASS) uart_send_string_p(PSTR("PASS"));
-	else uart_send_string_p(PSTR("FAIL"));
-	uart_send_string_p(PSTR("\n\rWHITE: "));
-	if(l[3] == PASS) uart_send_string_p(PSTR("PASS"));
-	else uart_send_string_p(PSTR("FAIL"));
+	uart_printf_P(PSTR("\n\r\n\r [ 4 ] LEDs COLORS & BRIGHTNESS\n\rRED: %S\n\rGREEN: %S\n\rBLUE: %S\n\rWHITE: %S"),
+		pass_fail(l[0]), pass_fail(l[1]), pass_fail(l[2]), pass_fail(l[3]));
+
+	// Print the supply faults log
+	uint8_t f[4];
+	rom_query_fault(f);
+	uart_printf_P(PSTR("\n\r\n\r [ 5 ] SUPPLY FAULTS\n\rCount: %u"), f[0]);
+	if(f[0]){
+		uart_printf_P(PSTR("\n\rLast faults (hex): %x\n\rHV shutdown latency (us): %u"),
+			f[1], f[2] | ((uint16_t)f[3] << 8));
+	}
+
+	// Print the RTC calibration
+	uart_printf_P(PSTR("\n\r\n\r [ 6 ] RTC DRIFT CORRECTION (ppm): %d"), rom_query_rtc_cal());
 
 	uart_send_string_p(PSTR("\n\r\n\r < REPORT END >\n\r"));
 }
 
+/*===========================================================================*/
+/*
+* Reads the RTC drift correction (ppm) from the serial port and stores it.
+* Positive values mean the crystal runs slow. The drift is measured against
+* a reference clock, e.g. over a few days.
+*/
+static void set_rtc_calibration(void)
+{
+	char c;
+	int16_t ppm = 0;
+	uint8_t neg = FALSE;
+
+	uart_printf_P(PSTR("\n\rRTC drift correction (ppm): %d\n\rNew value, ENTER to store: "),
+		rom_query_rtc_cal());
 
+	c = uart_read_char();
+	if(c == '-'){
+		neg = TRUE;
+		uart_send_char(c);
+		c = uart_read_char();
+	}
+	while((c >= '0') && (c <= '9') && (ppm <= RTC_PPM_MAX)){
+		uart_send_char(c);
+		ppm = (ppm * 10) + (c - '0');
+		c = uart_read_char();
+	}
+	if(((c != '\r') && (c != '\n')) || (ppm > RTC_PPM_MAX)){
+		uart_send_string_p(PSTR("\n\rInvalid value. Range is +/-500"));
+		return;
+	}
+	if(neg) ppm = -ppm;
+	rom_store_rtc_cal(ppm);
+	timer_rtc_calibrate(ppm);
+	uart_send_string_p(PSTR("\n\rStored"));
+}
+
+/*===========================================================================*/
+static const char *pass_fail(uint8_t result)
+{
+	return (result == PASS) ? PSTR("PASS") : PSTR("FAIL");
+}
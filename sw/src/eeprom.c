@@ -16,8 +16,16 @@
 
 #include "eeprom.h"
 #include "config.h"
+#include "menu_alarm.h"
+#include "menu_time.h"
+#include "timers.h"
+#include "util.h"
 
 #include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <stdint.h>
+#include <util/crc16.h>
 
 /******************************************************************************
 ***************** E E P R O M   V A R S   D E F I N I T I O N *****************
@@ -30,11 +38,48 @@ uint8_t EEMEM test_voltages[24];	// Stores voltages check result
 uint8_t EEMEM test_rtc[7];			// RTC signal test result
 uint8_t EEMEM test_buzzer;
 uint8_t EEMEM test_leds[4];
+uint8_t EEMEM fault_log[4];			// supply faults: count, last faults, latency
+int16_t EEMEM rtc_cal[2];			// RTC drift (ppm) and its complement
+settings_s EEMEM settings_ring[ROM_SETTINGS_SLOTS];	// user settings
+journal_s EEMEM journal_ring[ROM_JOURNAL_SLOTS];		// time journal
+uint8_t EEMEM reset_head;			// next slot of the reset log
+reset_s EEMEM reset_ring[ROM_RESET_SLOTS];			// reset log
+
+/******************************************************************************
+*************** G L O B A L   V A R S   D E F I N I T I O N S *****************
+******************************************************************************/
+
+/*
+* Write queue: the system states are the only producer and the EEPROM ready
+* ISR the only consumer. Each byte to be written takes one entry.
+*/
+static volatile uint16_t wq_addr[ROM_QUEUE_SIZE];
+static volatile uint8_t wq_data[ROM_QUEUE_SIZE];
+static volatile uint8_t wq_head = 0;
+static volatile uint8_t wq_tail = 0;
+
+// Copy of the last settings record stored, and its ring slot
+static settings_s settings;
+static uint8_t settings_slot = ROM_SETTINGS_SLOTS - 1;
+
+// Newest time journal record: slot and sequence number
+static uint8_t journal_slot = ROM_JOURNAL_SLOTS - 1;
+static uint8_t journal_seq = 0;
+
+uint16_t rom_journal_latency = 0;
 
 /******************************************************************************
 ******************* F U N C T I O N   D E F I N I T I O N S *******************
 ******************************************************************************/
 
+static void rom_read(void *dst, const void *src, uint8_t n);
+static void rom_drain(void);
+static uint8_t settings_crc(const settings_s *s);
+static void settings_build(settings_s *s);
+static uint8_t journal_crc(const journal_s *j);
+static void journal_build(journal_s *j);
+static void journal_erase_next(void);
+
 /*===========================================================================*/
 /*
 * Initial, unprogrammed content of ROM is all bytes 0xFF. Thus, it must be
@@ -46,31 +91,348 @@ void rom_init(void)
 
 	if(val != 0xAA){
 		// ROM not initialized.
-		eeprom_update_byte(&sys_blank, 0xAA);
+		rom_write_byte(&sys_blank, 0xAA);
 		// reset test counter
-		eeprom_update_byte(&test_cnt, 0);
+		rom_write_byte(&test_cnt, 0);
 		
 		// reset test buzzer result
-		eeprom_update_byte(&test_buzzer, 0);
+		rom_write_byte(&test_buzzer, 0);
 		
 		uint8_t v[24];
 		for(uint8_t i = 0; i < 24; i++)
 			v[i] = 0;
 		// reset test voltages result
-		eeprom_update_block((const void *)v, (void *)test_voltages, sizeof(test_voltages));
+		rom_write_block((void *)test_voltages, (const void *)v, sizeof(test_voltages));
 		// reset test rtc result
-		eeprom_update_block((const void *)v, (void *)test_rtc, sizeof(test_rtc));
+		rom_write_block((void *)test_rtc, (const void *)v, sizeof(test_rtc));
 		// reset test leds result
-		eeprom_update_block((const void *)v, (void *)test_leds, sizeof(test_leds));
+		rom_write_block((void *)test_leds, (const void *)v, sizeof(test_leds));
+		// reset supply faults log
+		rom_write_block((void *)fault_log, (const void *)v, sizeof(fault_log));
+		// no RTC drift correction
+		rom_store_rtc_cal(0);
 	} 
 }
 
+/*===========================================================================*/
+/*
+* Queues n bytes to be written at EEPROM address dst. Data is copied, so the
+* source buffer can be reused right away. Bytes are written one at a time by
+* the EEPROM ready ISR, and only if they differ from the stored ones (same as
+* eeprom_update_block). If the queue is full, the oldest entry is written
+* synchronously to make room.
+*/
+void rom_write_block(void *dst, const void *src, uint8_t n)
+{
+	uint16_t addr = (uint16_t)dst;
+	const uint8_t *p = (const uint8_t *)src;
+	uint8_t next;
+
+	while(n--){
+		next = (wq_head + 1) & ROM_QUEUE_MASK;
+		if(next == wq_tail) rom_drain();
+		wq_addr[wq_head] = addr++;
+		wq_data[wq_head] = *p++;
+		wq_head = next;
+	}
+	// the ISR triggers as soon as the EEPROM is ready
+	EECR |= (1<<EERIE);
+}
+
+/*===========================================================================*/
+void rom_write_byte(uint8_t *dst, uint8_t val)
+{
+	rom_write_block((void *)dst, (const void *)&val, 1);
+}
+
+/*===========================================================================*/
+/*
+* Number of bytes waiting in the write queue
+*/
+uint8_t rom_pending(void)
+{
+	return (wq_head - wq_tail) & ROM_QUEUE_MASK;
+}
+
+/*===========================================================================*/
+/*
+* Write barrier: returns once all queued bytes are written into the EEPROM.
+* Works with interrupts disabled (the EEPROM is polled). It takes 3.4ms per
+* queued byte, so it's only used before going to sleep (and before handing
+* over to the bootloader, through peripherals_disable()).
+*/
+void rom_flush(void)
+{
+	while(wq_head != wq_tail) rom_drain();
+	// wait for the last write to finish
+	while(EECR & (1<<EEPE));
+}
+
+/*===========================================================================*/
+/*
+* EEPROM ready routine. Executed from the EE_READY ISR whenever the EEPROM
+* is not busy. Unchanged bytes are skipped, and up to one byte is written
+* per execution (a write takes 3.4ms). When the queue is empty, the
+* interrupt is disabled.
+*/
+void rom_isr(void)
+{
+	uint16_t addr;
+	uint8_t data;
+
+	while(wq_tail != wq_head){
+		addr = wq_addr[wq_tail];
+		data = wq_data[wq_tail];
+		wq_tail = (wq_tail + 1) & ROM_QUEUE_MASK;
+
+		EEAR = addr;
+		EECR |= (1<<EERE);
+		if(EEDR != data){
+			// atomic erase & write (EEPM = 0). EEPE must be set within 4
+			// clock cycles after EEMPE
+			EEDR = data;
+			EECR |= (1<<EEMPE);
+			EECR |= (1<<EEPE);
+			return;
+		}
+	}
+	EECR &= ~(1<<EERIE);
+}
+
+/*===========================================================================*/
+/*
+* Restores the user settings. The whole ring is read at once, and the valid
+* record (right version and CRC) with the highest sequence number is the
+* newest one. Sequence numbers wrap around, so they are compared by their
+* difference. If no valid record is found, system defaults are kept.
+*/
+void rom_settings_load(void)
+{
+	settings_s ring[ROM_SETTINGS_SLOTS];
+	settings_s *s = 0;
+
+	rom_read((void *)ring, (const void *)settings_ring, sizeof(ring));
+
+	for(uint8_t i = 0; i < ROM_SETTINGS_SLOTS; i++){
+		if(ring[i].version != ROM_SETTINGS_VERSION) continue;
+		if(ring[i].crc != settings_crc(&ring[i])) continue;
+		if((s == 0) || ((int8_t)(ring[i].seq - s->seq) > 0)){
+			s = &ring[i];
+			settings_slot = i;
+		}
+	}
+
+	if(s == 0){
+		// nothing stored yet: keep defaults as the reference record
+		settings_build(&settings);
+		settings.seq = 0;
+		settings.crc = settings_crc(&settings);
+		return;
+	}
+	settings = *s;
+
+	time.hour_mode = s->hour_mode;
+	alarm.hour_mode = s->hour_mode;
+	// defaults are 12:00 AM; in 24h mode that is 00:00
+	if((s->hour_mode == MODE_24H) && (time.hour == 12)) time.hour = 0;
+	alarm.hour = s->alarm_hour;
+	alarm.min = s->alarm_min;
+	alarm.day_period = s->alarm_period;
+	alarm.active = s->alarm_active;
+	alarm.theme = s->alarm_theme;
+	display.mode = s->disp_mode;
+	update_time_variables();
+}
+
+/*===========================================================================*/
+/*
+* Stores the user settings, only if they changed since the last record. The
+* record goes to the next slot of the ring, so the EEPROM wear is spread
+* over all slots. It's called some time after the user leaves the menus, so
+* all changes made during a visit to the menus result in a single write.
+*/
+void rom_settings_save(void)
+{
+	settings_s s;
+
+	settings_build(&s);
+	s.seq = settings.seq;
+	s.crc = settings_crc(&s);
+	if(s.crc == settings.crc){
+		// compare the data only if the CRC matches (most of the times)
+		uint8_t *a = (uint8_t *)&s;
+		uint8_t *b = (uint8_t *)&settings;
+		uint8_t i;
+		for(i = 0; i < sizeof(settings_s); i++)
+			if(a[i] != b[i]) break;
+		if(i == sizeof(settings_s)) return;
+	}
+
+	s.seq++;
+	s.crc = settings_crc(&s);
+	settings_slot++;
+	if(settings_slot >= ROM_SETTINGS_SLOTS) settings_slot = 0;
+	rom_write_block((void *)&settings_ring[settings_slot], (const void *)&s, sizeof(settings_s));
+	settings = s;
+}
+
+/*===========================================================================*/
+/*
+* Invalidates all stored records, so the next boot uses the system defaults
+*/
+void rom_settings_clear(void)
+{
+	for(uint8_t i = 0; i < ROM_SETTINGS_SLOTS; i++)
+		rom_write_byte(&settings_ring[i].version, 0xFF);
+	settings_build(&settings);
+	settings.seq = 0;
+	settings.crc = settings_crc(&settings);
+	settings_slot = ROM_SETTINGS_SLOTS - 1;
+}
+
+/*===========================================================================*/
+/*
+* Restores the time from the journal, when the time has been lost (no coin
+* cell battery). It must run after rom_settings_load(), since the time is
+* converted into the restored hour mode. The restored time is older than
+* the real one, so it's flagged as stale until the user sets it.
+*/
+void rom_journal_load(void)
+{
+	journal_s ring[ROM_JOURNAL_SLOTS];
+	journal_s *j = 0;
+
+	rom_read((void *)ring, (const void *)journal_ring, sizeof(ring));
+
+	for(uint8_t i = 0; i < ROM_JOURNAL_SLOTS; i++){
+		if(ring[i].hour > 23) continue;		// erased or invalidated
+		if(ring[i].crc != journal_crc(&ring[i])) continue;
+		if((j == 0) || ((int8_t)(ring[i].seq - j->seq) > 0)){
+			j = &ring[i];
+			journal_slot = i;
+		}
+	}
+
+	if(j != 0){
+		journal_seq = j->seq;
+		time.sec = j->sec;
+		time.min = j->min;
+		if(j->hour < 12) time.day_period = PERIOD_AM;
+		else time.day_period = PERIOD_PM;
+		if(time.hour_mode == MODE_24H){
+			time.hour = j->hour;
+		} else {
+			time.hour = j->hour % 12;
+			if(time.hour == 0) time.hour = 12;
+		}
+		time.stale = TRUE;
+		update_time_variables();
+	}
+	journal_erase_next();
+}
+
+/*===========================================================================*/
+/*
+* Periodic checkpoint: in case the power loss capture doesn't make it in
+* time, the time restored is at most ROM_JOURNAL_PERIOD minutes old. Written
+* through the queue, like any other data.
+*/
+void rom_journal_checkpoint(void)
+{
+	journal_s j;
+
+	journal_build(&j);
+	journal_slot++;
+	if(journal_slot >= ROM_JOURNAL_SLOTS) journal_slot = 0;
+	journal_seq = j.seq;
+	rom_write_block((void *)&journal_ring[journal_slot], (const void *)&j, sizeof(journal_s));
+	journal_erase_next();
+}
+
+/*===========================================================================*/
+/*
+* Power loss capture. Executed from the external power ISR, while the
+* remaining capacitance still powers the MCU. The queue is bypassed: the
+* current time is written straight into the next slot of the journal, which
+* was erased beforehand, so each byte takes a write-only cycle (1.8ms)
+* instead of an erase & write one (3.4ms). The time taken (until the record
+* is written) is measured with the 1ms timer and kept in
+* rom_journal_latency. It's bounded by ROM_JOURNAL_MAX_US, and checked
+* against it when the system wakes up.
+*/
+void rom_journal_capture(void)
+{
+	journal_s j;
+	const uint8_t *p = (const uint8_t *)&j;
+	uint16_t addr;
+	uint16_t t0 = TCNT3;
+	uint8_t ms = 0;
+	uint8_t mode = (1<<EEPM1);		// write only
+	uint8_t i;
+
+	journal_build(&j);
+	journal_slot++;
+	if(journal_slot >= ROM_JOURNAL_SLOTS) journal_slot = 0;
+	journal_seq = j.seq;
+	addr = (uint16_t)&journal_ring[journal_slot];
+
+	/*
+	* The 1ms timer compare flag is polled (and cleared) to count the elapsed
+	* milliseconds. A few ticks are lost, but the system is going to sleep.
+	*/
+	while(EECR & (1<<EEPE)){
+		if(TIFR3 & (1<<OCF3A)){ TIFR3 = (1<<OCF3A); ms++; }
+	}
+	// if the slot isn't erased (e.g. power lost right after boot), the
+	// slower erase & write cycle is required
+	for(i = 0; i < sizeof(journal_s); i++){
+		EEAR = addr + i;
+		EECR |= (1<<EERE);
+		if(EEDR != 0xFF) mode = 0;
+	}
+	for(i = 0; i < sizeof(journal_s); i++){
+		EEAR = addr + i;
+		EEDR = p[i];
+		EECR = (EECR & (1<<EERIE)) | mode;
+		EECR |= (1<<EEMPE);
+		EECR |= (1<<EEPE);
+		while(EECR & (1<<EEPE)){
+			if(TIFR3 & (1<<OCF3A)){ TIFR3 = (1<<OCF3A); ms++; }
+		}
+	}
+	// back to erase & write mode, used by the write queue
+	EECR &= ~((1<<EEPM1) | (1<<EEPM0));
+	// TC3 counts 4us ticks, 250 per ms
+	rom_journal_latency = (uint16_t)((ms * 250U) + TCNT3 - t0) * 4;
+
+	// queued bytes for this slot (its erase) would overwrite the record
+	for(i = wq_tail; i != wq_head; i = (i + 1) & ROM_QUEUE_MASK){
+		if((wq_addr[i] >= addr) && (wq_addr[i] < (addr + sizeof(journal_s))))
+			wq_data[i] = p[wq_addr[i] - addr];
+	}
+	// Queue the erase of the next slot. The system states only use the
+	// queue with interrupts disabled, so it's safe from this ISR
+	journal_erase_next();
+}
+
+/*===========================================================================*/
+/*
+* Invalidates all journal records, so the next boot uses the default time
+*/
+void rom_journal_clear(void)
+{
+	for(uint8_t i = 0; i < ROM_JOURNAL_SLOTS; i++)
+		rom_write_byte(&journal_ring[i].hour, 0xFF);
+}
+
 /*===========================================================================*/
 uint8_t rom_increase_test_cnt(void)
 {
-	uint8_t val = eeprom_read_byte(&test_cnt);
+	uint8_t val;
+
+	rom_read((void *)&val, (const void *)&test_cnt, 1);
 	val++;
-	eeprom_update_byte(&test_cnt, val);
+	rom_write_byte(&test_cnt, val);
 
 	return val;
 }
@@ -78,7 +440,10 @@ uint8_t rom_increase_test_cnt(void)
 /*===========================================================================*/
 uint8_t rom_query_test_cnt(void)
 {
-	return eeprom_read_byte(&test_cnt);
+	uint8_t val;
+
+	rom_read((void *)&val, (const void *)&test_cnt, 1);
+	return val;
 }
 
 /*===========================================================================*/
@@ -101,70 +466,272 @@ uint8_t rom_query_test_cnt(void)
 void rom_store_voltages_results(uint8_t *t1, uint8_t *t2, uint8_t *t3)
 {
 	for(uint8_t i = 0; i < 8; i++){
-		if(*(t1 + i) == TRUE) eeprom_update_byte((test_voltages + i), PASS);
-		else eeprom_update_byte((test_voltages + i), FAIL);		
+		if(*(t1 + i) == TRUE) rom_write_byte((test_voltages + i), PASS);
+		else rom_write_byte((test_voltages + i), FAIL);		
 	}
 	for(uint8_t i = 0; i < 8; i++){
-		if(*(t2 + i) == TRUE) eeprom_update_byte((test_voltages + 8 + i), PASS);
-		else eeprom_update_byte((test_voltages + 8 + i), FAIL);		
+		if(*(t2 + i) == TRUE) rom_write_byte((test_voltages + 8 + i), PASS);
+		else rom_write_byte((test_voltages + 8 + i), FAIL);		
 	}
 	for(uint8_t i = 0; i < 8; i++){
-		if(*(t3 + i) == TRUE) eeprom_update_byte((test_voltages + 16 + i), PASS);
-		else eeprom_update_byte((test_voltages + 16 + i), FAIL);		
+		if(*(t3 + i) == TRUE) rom_write_byte((test_voltages + 16 + i), PASS);
+		else rom_write_byte((test_voltages + 16 + i), FAIL);		
 	}
 }
 
 /*===========================================================================*/
 void rom_store_timing_results(uint8_t clock_ok, uint16_t *times)
 {
-	if(clock_ok) eeprom_update_byte(test_rtc, PASS);
-	else eeprom_update_byte(test_rtc, FAIL);
+	if(clock_ok) rom_write_byte(test_rtc, PASS);
+	else rom_write_byte(test_rtc, FAIL);
 
-	eeprom_update_block((const void *)times, (void *)(test_rtc + 1), sizeof(test_rtc) - 1);
+	rom_write_block((void *)(test_rtc + 1), (const void *)times, sizeof(test_rtc) - 1);
 }
 
 /*===========================================================================*/
 void rom_store_buzzer_results(uint8_t buzzer_ok)
 {
-	if(buzzer_ok) eeprom_update_byte(&test_buzzer, PASS);
-	else  eeprom_update_byte(&test_buzzer, FAIL);
+	if(buzzer_ok) rom_write_byte(&test_buzzer, PASS);
+	else  rom_write_byte(&test_buzzer, FAIL);
 }
 
 /*===========================================================================*/
 void rom_store_leds_results(uint8_t *leds_ok)
 {
 	for(uint8_t i = 0; i < 4; i++){
-		if(*(leds_ok + i) == TRUE) eeprom_update_byte((test_leds + i), PASS);
-		else eeprom_update_byte((test_leds + i), FAIL);		
+		if(*(leds_ok + i) == TRUE) rom_write_byte((test_leds + i), PASS);
+		else rom_write_byte((test_leds + i), FAIL);		
 	}
 }
 
 /*===========================================================================*/
 void rom_query_voltages_test(uint8_t *v)
 {
-	eeprom_read_block((void *)v, test_voltages, sizeof(test_voltages));
+	rom_read((void *)v, (const void *)test_voltages, sizeof(test_voltages));
 }
 
 /*===========================================================================*/
 uint8_t rom_query_rtc_ok_test(void)
 {
-	return eeprom_read_byte(test_rtc);
+	uint8_t val;
+
+	rom_read((void *)&val, (const void *)test_rtc, 1);
+	return val;
 }
 
 /*===========================================================================*/
 void rom_query_rtc_time_test(uint16_t *t)
 {
-	eeprom_read_block((void *)t, test_rtc + 1, sizeof(test_rtc) - 1);
+	rom_read((void *)t, (const void *)(test_rtc + 1), sizeof(test_rtc) - 1);
 }
 
 /*===========================================================================*/
 uint8_t rom_query_buzzer_ok_test(void)
 {
-	return eeprom_read_byte(&test_buzzer);
+	uint8_t val;
+
+	rom_read((void *)&val, (const void *)&test_buzzer, 1);
+	return val;
 }
 
 /*===========================================================================*/
 void rom_query_leds_test(uint8_t *l)
 {
-	eeprom_read_block((void *)l, test_leds, sizeof(test_leds));
-}
\ No newline at end of file
+	rom_read((void *)l, (const void *)test_leds, sizeof(test_leds));
+}
+
+/*===========================================================================*/
+/*
+* Logs a supply fault (adc_faults() bits) and the high voltage shutdown
+* latency (us). The fault counter saturates at 255
+*/
+void rom_store_fault(uint8_t faults, uint16_t latency)
+{
+	uint8_t f[4];
+
+	rom_read((void *)f, (const void *)fault_log, sizeof(fault_log));
+	if(f[0] < 0xFF) f[0]++;
+	f[1] = faults;
+	f[2] = (uint8_t)latency;
+	f[3] = (uint8_t)(latency >> 8);
+	rom_write_block((void *)fault_log, (const void *)f, sizeof(fault_log));
+}
+
+/*===========================================================================*/
+/*
+* Supply faults log: count, last faults and latency (LSB first)
+*/
+void rom_query_fault(uint8_t *f)
+{
+	rom_read((void *)f, (const void *)fault_log, sizeof(fault_log));
+}
+
+/*===========================================================================*/
+/*
+* Stores the RTC drift calibration (ppm). Its complement is stored as well,
+* so an unprogrammed or corrupted value is detected
+*/
+void rom_store_rtc_cal(int16_t ppm)
+{
+	int16_t c[2] = {ppm, ~ppm};
+
+	rom_write_block((void *)rtc_cal, (const void *)c, sizeof(rtc_cal));
+}
+
+/*===========================================================================*/
+/*
+* RTC drift calibration (ppm). 0 if it's not valid
+*/
+int16_t rom_query_rtc_cal(void)
+{
+	int16_t c[2];
+
+	rom_read((void *)c, (const void *)rtc_cal, sizeof(rtc_cal));
+	if(c[0] != (int16_t)~c[1]) return 0;
+	return c[0];
+}
+
+/*===========================================================================*/
+/*
+* Logs a reset: reset flags (MCUSR) and the system state that was running.
+* The oldest record is overwritten
+*/
+void rom_store_reset(uint8_t flags, uint8_t state)
+{
+	reset_s r = {flags, state};
+	uint8_t head;
+
+	rom_read((void *)&head, (const void *)&reset_head, 1);
+	if(head >= ROM_RESET_SLOTS) head = 0;		// unprogrammed
+	rom_write_block((void *)&reset_ring[head], (const void *)&r, sizeof(reset_s));
+	rom_write_byte(&reset_head, (head + 1) % ROM_RESET_SLOTS);
+}
+
+/*===========================================================================*/
+/*
+* Reset log record n, 0 being the newest one. Returns FALSE if it's empty
+*/
+uint8_t rom_query_reset(uint8_t n, reset_s *r)
+{
+	uint8_t head;
+
+	rom_read((void *)&head, (const void *)&reset_head, 1);
+	if((head >= ROM_RESET_SLOTS) || (n >= ROM_RESET_SLOTS)) return FALSE;
+	head = (head + ROM_RESET_SLOTS - 1 - n) % ROM_RESET_SLOTS;
+	rom_read((void *)r, (const void *)&reset_ring[head], sizeof(reset_s));
+	return r->flags != 0xFF;
+}
+
+/*-----------------------------------------------------------------------------
+-------------------------- L O C A L   F U N C T I O N S ----------------------
+-----------------------------------------------------------------------------*/
+
+/*===========================================================================*/
+/*
+* All reads go through here. Bytes still in the write queue are newer than
+* the EEPROM content, so they're taken from the queue instead (the newest
+* entry of an address wins). Only a write in progress is waited for (up to
+* 3.4ms): the queue isn't drained, so the system states keep running.
+*/
+static void rom_read(void *dst, const void *src, uint8_t n)
+{
+	uint8_t sreg = SREG;
+	uint16_t addr = (uint16_t)src;
+	uint8_t *p = (uint8_t *)dst;
+
+	cli();
+	eeprom_read_block(dst, src, n);
+	for(uint8_t i = wq_tail; i != wq_head; i = (i + 1) & ROM_QUEUE_MASK){
+		if((wq_addr[i] >= addr) && (wq_addr[i] < (addr + n)))
+			p[wq_addr[i] - addr] = wq_data[i];
+	}
+	SREG = sreg;
+}
+
+/*===========================================================================*/
+/*
+* Waits for the EEPROM and writes the next queued byte, with the ISR masked
+* so both don't race for the same entry
+*/
+static void rom_drain(void)
+{
+	uint8_t sreg = SREG;
+
+	cli();
+	while(EECR & (1<<EEPE));
+	rom_isr();
+	SREG = sreg;
+}
+
+/*===========================================================================*/
+static uint8_t settings_crc(const settings_s *s)
+{
+	const uint8_t *p = (const uint8_t *)s;
+	uint8_t crc = 0;
+
+	for(uint8_t i = 0; i < (sizeof(settings_s) - 1); i++)
+		crc = _crc8_ccitt_update(crc, p[i]);
+	return crc;
+}
+
+/*===========================================================================*/
+/*
+* Fills a settings record (except seq and crc) with the current values
+*/
+static void settings_build(settings_s *s)
+{
+	s->version = ROM_SETTINGS_VERSION;
+	s->hour_mode = time.hour_mode;
+	s->alarm_hour = alarm.hour;
+	s->alarm_min = alarm.min;
+	s->alarm_period = alarm.day_period;
+	s->alarm_active = alarm.active;
+	s->alarm_theme = alarm.theme;
+	s->disp_mode = display.mode;
+	s->crc = 0;
+}
+
+/*===========================================================================*/
+static uint8_t journal_crc(const journal_s *j)
+{
+	const uint8_t *p = (const uint8_t *)j;
+	uint8_t crc = 0;
+
+	for(uint8_t i = 0; i < (sizeof(journal_s) - 1); i++)
+		crc = _crc8_ccitt_update(crc, p[i]);
+	return crc;
+}
+
+/*===========================================================================*/
+/*
+* Fills a journal record with the current time, and the next sequence number
+*/
+static void journal_build(journal_s *j)
+{
+	uint8_t h = time.hour;
+
+	// 12h mode to 24h
+	if(time.hour_mode == MODE_12H){
+		if(h == 12) h = 0;
+		if(time.day_period == PERIOD_PM) h += 12;
+	}
+	j->seq = journal_seq + 1;
+	j->hour = h;
+	j->min = time.min;
+	j->sec = time.sec;
+	j->crc = journal_crc(j);
+}
+
+/*===========================================================================*/
+/*
+* Erases the slot after the newest journal record, ready for a power loss
+* capture. The erase is queued as a write of 0xFF bytes
+*/
+static void journal_erase_next(void)
+{
+	uint8_t next = journal_slot + 1;
+
+	if(next >= ROM_JOURNAL_SLOTS) next = 0;
+	for(uint8_t i = 0; i < sizeof(journal_s); i++)
+		rom_write_byte((uint8_t *)&journal_ring[next] + i, 0xFF);
+}
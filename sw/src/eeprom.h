@@ -19,12 +19,101 @@
 
 #include <stdint.h>
 
+/******************************************************************************
+***************** S T R U C T U R E   D E C L A R A T I O N S *****************
+******************************************************************************/
+
+/*
+* User settings record. The whole record is protected by a CRC-8, and the
+* version byte tells if the stored layout matches the current firmware
+*/
+typedef struct {
+	uint8_t version;		// ROM_SETTINGS_VERSION
+	uint8_t seq;			// sequence number, increased on every write
+	uint8_t hour_mode;		// 12/24h
+	uint8_t alarm_hour;
+	uint8_t alarm_min;
+	uint8_t alarm_period;	// AM/PM
+	uint8_t alarm_active;
+	uint8_t alarm_theme;
+	uint8_t disp_mode;		// transitions mode
+	uint8_t crc;			// CRC-8 of all the previous bytes
+} settings_s;
+
+/*
+* Time journal record. Hours are always stored in 24h format. The record is
+* kept small: it's written within the hold-up time after a power loss
+*/
+typedef struct {
+	uint8_t seq;			// sequence number, increased on every write
+	uint8_t hour;			// 0 to 23
+	uint8_t min;
+	uint8_t sec;
+	uint8_t crc;			// CRC-8 of all the previous bytes
+} journal_s;
+
+/*
+* Reset log record (see watchdog.c). An unprogrammed slot reads 0xFF flags
+*/
+typedef struct {
+	uint8_t flags;			// reset flags (MCUSR)
+	uint8_t state;			// system state running, or 0xFF if unknown
+} reset_s;
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Increase when the settings_s layout changes; older records are discarded
+#define ROM_SETTINGS_VERSION	0x01
+// Number of records in the wear leveling ring
+#define ROM_SETTINGS_SLOTS		8
+// Time in DISPLAY_TIME before changed settings are stored (ms)
+#define ROM_SETTINGS_DELAY		3000
+
+// Number of records in the time journal ring
+#define ROM_JOURNAL_SLOTS		16
+// Minutes between time journal checkpoints
+#define ROM_JOURNAL_PERIOD		15
+// Power loss capture latency bound (us): a write in progress (3.4ms) plus
+// one cycle per record byte. Write-only cycles (1.8ms) into an erased slot
+// take 12.4ms; the erase & write fallback (3.4ms) is the worst case
+#define ROM_JOURNAL_MAX_US		(3400 + (3400 * 5))
+
+// Number of records in the reset log ring
+#define ROM_RESET_SLOTS			8
+
+// Write queue size (bytes). Must be a power of 2
+#define ROM_QUEUE_SIZE			32
+#define ROM_QUEUE_MASK			(ROM_QUEUE_SIZE - 1)
+
+/******************************************************************************
+******************** E X T E R N A L   V A R I A B L E S **********************
+******************************************************************************/
+
+extern uint16_t rom_journal_latency;	// last power loss capture time (us)
+
 /******************************************************************************
 ****************** F U N C T I O N   P R O T O T Y P E S **********************
 ******************************************************************************/
 
 void rom_init(void);
 
+void rom_write_block(void *dst, const void *src, uint8_t n);
+void rom_write_byte(uint8_t *dst, uint8_t val);
+uint8_t rom_pending(void);
+void rom_flush(void);
+void rom_isr(void);
+
+void rom_settings_load(void);
+void rom_settings_save(void);
+void rom_settings_clear(void);
+
+void rom_journal_load(void);
+void rom_journal_checkpoint(void);
+void rom_journal_capture(void);
+void rom_journal_clear(void);
+
 uint8_t rom_increase_test_cnt(void);
 uint8_t rom_query_test_cnt(void);
 
@@ -39,4 +128,13 @@ void rom_query_rtc_time_test(uint16_t *t);
 uint8_t rom_query_buzzer_ok_test(void);
 void rom_query_leds_test(uint8_t *l);
 
+void rom_store_fault(uint8_t faults, uint16_t latency);
+void rom_query_fault(uint8_t *f);
+
+void rom_store_rtc_cal(int16_t ppm);
+int16_t rom_query_rtc_cal(void);
+
+void rom_store_reset(uint8_t flags, uint8_t state);
+uint8_t rom_query_reset(uint8_t n, reset_s *r);
+
 #endif /* EEPROM_H */
\ No newline at end of file
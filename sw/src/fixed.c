@@ -0,0 +1,95 @@
+/**
+ * @file fixed.c
+ * @brief Fixed-point arithmetic
+ *
+ * Integer replacements for the float math used with the ADC voltages. All
+ * of them truncate, as the float to integer conversions they replace
+ *
+ * @date 19.10.2026
+ *
+ */
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include "fixed.h"
+
+#include <stdint.h>
+
+/******************************************************************************
+******************* F U N C T I O N   D E F I N I T I O N S *******************
+******************************************************************************/
+
+/*===========================================================================*/
+/*
+* Reference correction: the ADC reference (MCU rail) voltage, in mV, deduced
+* from the reading of an internal reference of known voltage ref_mv
+*/
+uint16_t fx_vdd(uint16_t ref_raw, uint16_t ref_mv)
+{
+	if(ref_raw == 0) return 0xFFFF;
+	return (uint16_t)(((uint32_t)ref_mv * FX_ADC_TOP) / ref_raw);
+}
+
+/*===========================================================================*/
+/*
+* ADC counts expected for a voltage of mv millivolts at the ADC pin. The rail
+* voltage cancels out, so it's computed straight from the reference reading:
+* counts = (mv / vdd) * FX_ADC_TOP = mv * ref_raw / ref_mv
+*/
+uint16_t fx_counts(uint16_t mv, uint16_t ref_raw, uint16_t ref_mv)
+{
+	return (uint16_t)(((uint32_t)mv * ref_raw) / ref_mv);
+}
+
+/*===========================================================================*/
+uint16_t fx_percent(uint16_t x, uint8_t pct)
+{
+	return (uint16_t)(((uint32_t)x * pct) / 100);
+}
+
+/*===========================================================================*/
+/*
+* Divider scaling: voltage (mV) at the input of a resistor divider, from its
+* ADC reading. Reference corrected, as in fx_counts():
+* mv = (counts / FX_ADC_TOP) * vdd * divider = counts * ref_mv * divider / ref_raw
+* The division is split into quotient and remainder, so the intermediate
+* products fit into 32 bits: q * divider is about the rail voltage (mV)
+* times 1024, which fits up to about 4kV. Far above the 160V HV rail, and
+* above what a UQ6.10 divider (under 64) can measure anyway.
+*/
+uint32_t fx_volts(uint16_t counts, uint16_t ref_raw, uint16_t ref_mv, uq6_10_t divider)
+{
+	uint32_t t = (uint32_t)counts * ref_mv;
+	uint32_t q, r;
+
+	if(ref_raw == 0) return 0;
+	q = t / ref_raw;
+	r = t % ref_raw;
+	return ((q * divider) + ((r * divider) / ref_raw)) >> 10;
+}
+
+/*===========================================================================*/
+/*
+* Decimal formatting: writes mv as volts with two decimals, "12,34"
+* (up to 65535,99). s must hold at least 9 chars
+*/
+void fx_format(char *s, uint32_t mv)
+{
+	uint16_t v = (uint16_t)(mv / 1000);
+	uint8_t c = (uint8_t)((mv % 1000) / 10);
+	char digits[5];
+	uint8_t n = 0;
+
+	// integer part, least significant digit first
+	do {
+		digits[n++] = '0' + (v % 10);
+		v /= 10;
+	} while(v);
+	while(n) *s++ = digits[--n];
+	*s++ = ',';
+	*s++ = '0' + (c / 10);
+	*s++ = '0' + (c % 10);
+	*s = '\0';
+}
@@ -0,0 +1,46 @@
+/**
+ * @file fixed.h
+ * @brief Fixed-point arithmetic
+ *
+ * Integer replacements for the float math used with the ADC voltages.
+ * Voltages are handled in millivolts, and the resistor divider factors in
+ * UQ6.10 format (6 integer bits, 10 fractional bits)
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#ifndef FIXED_H
+#define FIXED_H
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include <stdint.h>
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+typedef uint16_t uq6_10_t;
+
+// Converts a constant into UQ6.10 (0 to 63.999). Only for constants: it's
+// computed at compile time, so no float code is linked
+#define UQ6_10(x)		((uq6_10_t)(((x) * 1024.0) + 0.5))
+
+// Full scale of the ADC readings: 10 bits ADC oversampled and decimated to
+// 12 bits (16 readings added, divided by 4)
+#define FX_ADC_TOP		(1023 << 2)
+
+/******************************************************************************
+******************** F U N C T I O N   P R O T O T Y P E S ********************
+******************************************************************************/
+
+uint16_t fx_vdd(uint16_t ref_raw, uint16_t ref_mv);
+uint16_t fx_counts(uint16_t mv, uint16_t ref_raw, uint16_t ref_mv);
+uint16_t fx_percent(uint16_t x, uint8_t pct);
+uint32_t fx_volts(uint16_t counts, uint16_t ref_raw, uint16_t ref_mv, uq6_10_t divider);
+void fx_format(char *s, uint32_t mv);
+
+#endif	/* FIXED_H */
@@ -13,18 +13,40 @@
 
 #include "init.h"
 #include "adc.h"
+#include "buttons.h"
 #include "buzzer.h"
 #include "config.h"
 #include "eeprom.h"
 #include "external_interrupt.h"
 #include "menu_alarm.h"
 #include "menu_time.h"
+#include "telemetry.h"
 #include "timers.h"
 #include "uart.h"
 
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <stdint.h>
 
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Phase not logged yet
+#define BOOT_NONE		0xFFFF
+
+// Phase names, as printed by boot_log_dump()
+static const char boot_names[BOOT_N][12] PROGMEM = {
+	"led blink", "banner", "test check", "hv settle", "voltages", "display"
+};
+
+/******************************************************************************
+*************** G L O B A L   V A R S   D E F I N I T I O N S *****************
+******************************************************************************/
+
+// Boot phases timestamps (ms)
+static uint16_t boot_times[BOOT_N];
+
 /******************************************************************************
 ******************* F U N C T I O N   D E F I N I T I O N S *******************
 ******************************************************************************/
@@ -41,6 +63,9 @@ void boot(void)
 	ports_init();
     system_defaults();
 	rom_init();
+	rom_settings_load();
+	rom_journal_load();
+	timer_rtc_calibrate(rom_query_rtc_cal());
 
     /*
     * Peripherals initialization.
@@ -62,6 +87,48 @@ void boot(void)
     pin_change_isr_init();
 }
 
+/*===========================================================================*/
+/*
+* Clears the boot log. Called right after the peripherals are enabled, both
+* at boot and when waking up.
+*/
+void boot_log_start(void)
+{
+	for(uint8_t i = 0; i < BOOT_N; i++)
+		boot_times[i] = BOOT_NONE;
+}
+
+/*===========================================================================*/
+/*
+* Logs the end of a boot phase. Only the first time after boot_log_start(),
+* so it can be called from code that runs again later (e.g. display_time)
+*/
+void boot_log(uint8_t phase)
+{
+	if(boot_times[phase] == BOOT_NONE){
+		boot_times[phase] = timer_base_now();
+		if(phase == BOOT_DISPLAY) telemetry_event(TLM_EV_BOOT, boot_times[phase], 0);
+	}
+}
+
+/*===========================================================================*/
+/*
+* Sends the boot log through the serial port: the time each phase ended and
+* how long it took. Skipped phases are not printed.
+*/
+void boot_log_dump(void)
+{
+	uint16_t prev = 0;
+
+	uart_send_string_p(PSTR("\n\rBOOT LOG (ms): end | duration"));
+	for(uint8_t i = 0; i < BOOT_N; i++){
+		if(boot_times[i] == BOOT_NONE) continue;
+		uart_printf_P(PSTR("\n\r - %S: %u | %u"), boot_names[i], boot_times[i],
+			boot_times[i] - prev);
+		prev = boot_times[i];
+	}
+}
+
 /*-----------------------------------------------------------------------------
 -------------------------- L O C A L   F U N C T I O N S ----------------------
 -----------------------------------------------------------------------------*/
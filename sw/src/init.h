@@ -16,10 +16,31 @@
 
 #include <stdint.h>
 
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+/*
+* Boot phases. Each one is logged when it ends, in ms since the general timer
+* was started (peripherals enabled). boot() runs before that: it only sets up
+* registers and reads the EEPROM.
+*/
+#define BOOT_BLINK		0	// onboard LED blink
+#define BOOT_BANNER		1	// UART firmware banner
+#define BOOT_TEST_CHECK	2	// production test pin check
+#define BOOT_SETTLE		3	// high voltage settle
+#define BOOT_VOLTAGES	4	// voltages check
+#define BOOT_DISPLAY	5	// first digit displayed (intro or time)
+#define BOOT_N			6
+
 /******************************************************************************
 ******************** F U N C T I O N   P R O T O T Y P E S ********************
 ******************************************************************************/
 
 void boot(void);
 
+void boot_log_start(void);
+void boot_log(uint8_t phase);
+void boot_log_dump(void);
+
 #endif	/* INIT_H */
\ No newline at end of file
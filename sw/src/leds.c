@@ -0,0 +1,330 @@
+/**
+ * @file leds.c
+ * @brief RGB LEDs color engine
+ *
+ * Gamma-corrected color output, HSV colors, the time-of-day palette and the
+ * LEDs animator (breathing effect driven from the 1ms timer interrupt)
+ *
+ * @date 19.10.2026
+ *
+ */
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include "leds.h"
+#include "config.h"
+#include "menu_time.h"
+#include "timers.h"
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Gamma correction table (gamma = 2.2). Maps a perceived brightness value
+// (0 to 255) into the PWM value that produces it. It replaces the quadratic
+// led_pwm[] table previously used for the breathing effect.
+static const uint8_t gamma8[] PROGMEM = {
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,
+	1,1,1,1,1,1,1,1,1,2,2,2,2,2,2,2,
+	3,3,3,3,3,4,4,4,4,5,5,5,5,6,6,6,
+	6,7,7,7,8,8,8,9,9,9,10,10,11,11,11,12,
+	12,13,13,13,14,14,15,15,16,16,17,17,18,18,19,19,
+	20,20,21,22,22,23,23,24,25,25,26,26,27,28,28,29,
+	30,30,31,32,33,33,34,35,35,36,37,38,39,39,40,41,
+	42,43,43,44,45,46,47,48,49,49,50,51,52,53,54,55,
+	56,57,58,59,60,61,62,63,64,65,66,67,68,69,70,71,
+	73,74,75,76,77,78,79,81,82,83,84,85,87,88,89,90,
+	91,93,94,95,97,98,99,100,102,103,105,106,107,109,110,111,
+	113,114,116,117,119,120,121,123,124,126,127,129,130,132,133,135,
+	137,138,140,141,143,145,146,148,149,151,153,154,156,158,159,161,
+	163,165,166,168,170,172,173,175,177,179,181,182,184,186,188,190,
+	192,194,196,197,199,201,203,205,207,209,211,213,215,217,219,221,
+	223,225,227,229,231,234,236,238,240,242,244,246,248,251,253,255
+};
+
+/*
+* Day palette: keyframes of the LEDs color along the day. Each keyframe is
+* an HSV color placed at a given minute of the day (0 to 1439). Colors in
+* between two keyframes are linearly interpolated; the last keyframe wraps
+* around to the first one at midnight. Keyframes must be sorted by minute.
+*/
+typedef struct {
+	uint16_t minute;
+	hsv_s color;
+} keyframe_s;
+
+static const keyframe_s day_palette[] PROGMEM = {
+	{   0, {175, 110, 140}},	// night: soft blue-violet
+	{ 330, {175, 110, 140}},	// 05:30
+	{ 420, { 14, 255, 110}},	// 07:00 sunrise: orange
+	{ 600, { 24, 255, 120}},	// 10:00 day: amber
+	{ 960, { 24, 255, 120}},	// 16:00
+	{1140, {  5, 240, 110}},	// 19:00 sunset: red-orange
+	{1260, {190, 170, 130}},	// 21:00 dusk: violet
+};
+
+#define DAY_PALETTE_N	(sizeof(day_palette)/sizeof(keyframe_s))
+#define DAY_MINUTES		1440
+
+/******************************************************************************
+*************** G L O B A L   V A R S   D E F I N I T I O N S *****************
+******************************************************************************/
+
+// Current color, in 8.8 fixed point (one per channel: R, G, B), and the
+// increment added every tick while a fade is running
+static uint16_t color[3];
+static int16_t delta[3];
+static uint8_t target[3];
+static uint16_t fade_ticks = 0;
+
+// Animator state. The phase accumulator covers one breathing period with its
+// full 32-bit range; it is advanced every ms by leds_isr() and locked to the
+// RTC once per second by leds_rtc_sync()
+static volatile uint8_t anim_mode = LEDS_MANUAL;
+static volatile uint32_t phase = 0;
+static volatile uint8_t cycle = 0;
+
+/******************************************************************************
+******************* F U N C T I O N   D E F I N I T I O N S *******************
+******************************************************************************/
+
+static void keyframe_rgb(uint8_t k, rgb_s *rgb);
+static void fade_tick(void);
+
+/*===========================================================================*/
+/*
+* Integer HSV to RGB conversion. The hue circle is split in 6 regions of
+* 43 units each; no floating-point operations are involved.
+*/
+void leds_hsv_to_rgb(const hsv_s *hsv, rgb_s *rgb)
+{
+	uint8_t region, rem, p, q, t;
+
+	if(hsv->s == 0){
+		rgb->r = hsv->v;
+		rgb->g = hsv->v;
+		rgb->b = hsv->v;
+		return;
+	}
+
+	region = hsv->h / 43;
+	rem = (hsv->h - (region * 43)) * 6;
+
+	p = (uint8_t)(((uint16_t)hsv->v * (255 - hsv->s)) >> 8);
+	q = (uint8_t)(((uint16_t)hsv->v * (255 - (((uint16_t)hsv->s * rem) >> 8))) >> 8);
+	t = (uint8_t)(((uint16_t)hsv->v * (255 - (((uint16_t)hsv->s * (255 - rem)) >> 8))) >> 8);
+
+	switch(region){
+		case 0:	rgb->r = hsv->v; rgb->g = t; rgb->b = p; break;
+		case 1:	rgb->r = q; rgb->g = hsv->v; rgb->b = p; break;
+		case 2:	rgb->r = p; rgb->g = hsv->v; rgb->b = t; break;
+		case 3:	rgb->r = p; rgb->g = q; rgb->b = hsv->v; break;
+		case 4:	rgb->r = t; rgb->g = p; rgb->b = hsv->v; break;
+		default: rgb->r = hsv->v; rgb->g = p; rgb->b = q; break;
+	}
+}
+
+/*===========================================================================*/
+/*
+* Returns the day palette color for the given minute of the day. The color
+* is interpolated between the two surrounding keyframes.
+*/
+void leds_schedule_color(uint16_t minute, rgb_s *rgb)
+{
+	uint8_t k = 0;
+	uint16_t m0, m1, span, pos;
+	rgb_s c0, c1;
+
+	if(minute >= DAY_MINUTES) minute = 0;
+
+	// find the last keyframe placed before (or at) the given minute
+	while((k < (DAY_PALETTE_N - 1)) && (pgm_read_word(&day_palette[k + 1].minute) <= minute))
+		k++;
+
+	m0 = pgm_read_word(&day_palette[k].minute);
+	if(k < (DAY_PALETTE_N - 1)) m1 = pgm_read_word(&day_palette[k + 1].minute);
+	else m1 = DAY_MINUTES + pgm_read_word(&day_palette[0].minute);
+	span = m1 - m0;
+	pos = minute - m0;
+
+	keyframe_rgb(k, &c0);
+	keyframe_rgb((k < (DAY_PALETTE_N - 1)) ? (k + 1) : 0, &c1);
+
+	// linear interpolation, pos/span scaled to 0..256. 32 bits products: a
+	// 255 delta times 256 doesn't fit in an int
+	pos = (uint16_t)(((uint32_t)pos << 8) / span);
+	rgb->r = c0.r + (int16_t)(((int32_t)c1.r - c0.r) * pos / 256);
+	rgb->g = c0.g + (int16_t)(((int32_t)c1.g - c0.g) * pos / 256);
+	rgb->b = c0.b + (int16_t)(((int32_t)c1.b - c0.b) * pos / 256);
+}
+
+/*===========================================================================*/
+/*
+* Current time expressed in minutes since midnight (0 to 1439), regardless
+* of the hour mode
+*/
+uint16_t leds_time_of_day(void)
+{
+	uint8_t h = time.hour;
+
+	if(time.hour_mode == MODE_12H){
+		h %= 12;
+		if(time.day_period == PERIOD_PM) h += 12;
+	}
+
+	return ((uint16_t)h * 60) + time.min;
+}
+
+/*===========================================================================*/
+/*
+* Starts a fade from the current color to the given one. The per-tick
+* increment is computed once here; the animator just adds it, so the color is
+* never recomputed from scratch while fading. If ticks is 0 (or 1), the new
+* color is applied immediately.
+*/
+void leds_fade_to(const rgb_s *rgb, uint16_t ticks)
+{
+	target[0] = rgb->r;
+	target[1] = rgb->g;
+	target[2] = rgb->b;
+
+	for(uint8_t i = 0; i < 3; i++){
+		if(ticks > 1){
+			int32_t diff = ((int32_t)target[i] << 8) - (int32_t)color[i];
+			delta[i] = (int16_t)(diff / (int32_t)ticks);
+		} else {
+			color[i] = (uint16_t)target[i] << 8;
+			delta[i] = 0;
+		}
+	}
+	fade_ticks = (ticks > 1) ? ticks : 0;
+}
+
+/*===========================================================================*/
+/*
+* Writes the current color to the LEDs, scaled by a (perceived) brightness
+* level from 0 to 255, and gamma corrected. Compare registers are written
+* directly: they are double buffered in fast PWM mode, so the new duty cycle
+* takes effect at the next PWM period without restarting the counters.
+*/
+void leds_output(uint8_t level)
+{
+	uint8_t out[3];
+
+	for(uint8_t i = 0; i < 3; i++){
+		uint8_t c = (uint8_t)(color[i] >> 8);
+		c = (uint8_t)(((uint16_t)c * ((uint16_t)level + 1)) >> 8);
+		out[i] = pgm_read_byte(&gamma8[c]);
+	}
+	R_LED = out[0];
+	G_LED = out[1];
+	B_LED = out[2];
+}
+
+/*===========================================================================*/
+/*
+* Selects the animator mode. Nothing is done if the mode does not change, so
+* it is safe to call it in every loop execution. PWM timers are started (or 
+* stopped) here; from then on, the LEDs are driven by leds_isr().
+*/
+void leds_animate(uint8_t mode)
+{
+	if(mode == anim_mode) return;
+
+	anim_mode = mode;
+	if(mode == LEDS_OFF) {
+		timer_leds_set(DISABLE, 0, 0, 0);
+	} else if(mode != LEDS_MANUAL) {
+		timer_leds_set(ENABLE, R_LED, G_LED, B_LED);
+		cycle = 0;
+	}
+}
+
+/*===========================================================================*/
+/*
+* LEDs animator. Called from the 1ms timer ISR:
+* - advances the color fade, if any
+* - advances the phase accumulator and computes the brightness level as a
+*   triangle wave from its top bits: 2 seconds up, 2 seconds down
+* - writes the PWM compare registers
+*/
+void leds_isr(void)
+{
+	uint8_t level;
+	uint16_t p;
+
+	if((anim_mode == LEDS_MANUAL) || (anim_mode == LEDS_OFF)) return;
+
+	fade_tick();
+	phase += LEDS_PHASE_STEP;
+
+	if(anim_mode == LEDS_STEADY){
+		leds_output(255);
+		return;
+	}
+
+	p = (uint16_t)(phase >> 23);	// 0 to 511
+	level = (p < 256) ? (uint8_t)p : (uint8_t)(511 - p);
+
+	if(anim_mode == LEDS_CYCLE){
+		R_LED = (cycle == 0) ? pgm_read_byte(&gamma8[level]) : 0;
+		G_LED = (cycle == 1) ? pgm_read_byte(&gamma8[level]) : 0;
+		B_LED = (cycle == 2) ? pgm_read_byte(&gamma8[level]) : 0;
+	} else {
+		leds_output(level);
+	}
+}
+
+/*===========================================================================*/
+/*
+* Phase lock to the RTC. Called from the RTC ISR every second: each second 
+* is one quarter of the breathing period, so the phase is set to the start of
+* the corresponding quarter. This removes any drift of the 1ms time base. In
+* cycle mode, the color changes at the beginning of each period.
+*/
+void leds_rtc_sync(uint8_t sec)
+{
+	sec &= 0x03;
+	phase = (uint32_t)sec << 30;
+	if((sec == 0) && (anim_mode == LEDS_CYCLE)){
+		cycle++;
+		if(cycle >= 3) cycle = 0;
+	}
+}
+
+/*-----------------------------------------------------------------------------
+-------------------------- L O C A L   F U N C T I O N S ----------------------
+-----------------------------------------------------------------------------*/
+
+/*===========================================================================*/
+static void keyframe_rgb(uint8_t k, rgb_s *rgb)
+{
+	hsv_s hsv;
+
+	hsv.h = pgm_read_byte(&day_palette[k].color.h);
+	hsv.s = pgm_read_byte(&day_palette[k].color.s);
+	hsv.v = pgm_read_byte(&day_palette[k].color.v);
+	leds_hsv_to_rgb(&hsv, rgb);
+}
+
+/*===========================================================================*/
+/*
+* Advances the running fade by one step. The last step lands exactly on the
+* target, so rounding errors of the increment never accumulate.
+*/
+static void fade_tick(void)
+{
+	if(fade_ticks){
+		fade_ticks--;
+		for(uint8_t i = 0; i < 3; i++){
+			if(fade_ticks) color[i] += delta[i];
+			else color[i] = (uint16_t)target[i] << 8;
+		}
+	}
+}
@@ -0,0 +1,77 @@
+/**
+ * @file leds.h
+ * @brief RGB LEDs color engine
+ *
+ * Gamma-corrected color output, HSV colors, the time-of-day palette and the
+ * LEDs animator (breathing effect driven from the 1ms timer interrupt)
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#ifndef LEDS_H
+#define LEDS_H
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include <stdint.h>
+
+/******************************************************************************
+***************** S T R U C T U R E   D E C L A R A T I O N S *****************
+******************************************************************************/
+
+typedef struct {
+	uint8_t r;				// red component
+	uint8_t g;				// green component
+	uint8_t b;				// blue component
+} rgb_s;
+
+typedef struct {
+	uint8_t h;				// hue: 0 to 255 (full color wheel)
+	uint8_t s;				// saturation
+	uint8_t v;				// value (brightness)
+} hsv_s;
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Duration of the fade between two schedule colors (in ms)
+#define LEDS_FADE_TICKS		1000
+
+// Animator modes:
+// - Manual: animator is idle. LEDs are set directly with timer_leds_set()
+// - Breathing: brightness follows a triangle wave with a period of 4 seconds
+// - Steady: brightness does not change
+// - Cycle: breathing, but showing red, green and blue one at a time. The
+//   color changes with the RTC, once per breathing period
+// - Off: LEDs PWM is disabled
+#define LEDS_MANUAL		0x00
+#define LEDS_BREATHE	0xBB
+#define LEDS_CYCLE		0xCC
+#define LEDS_STEADY		0xEE
+#define LEDS_OFF		0xFF
+
+// Breathing period, and the matching phase accumulator increment per ms:
+// 2^32 / 4000 = 1073741.8
+#define LEDS_PERIOD		4000
+#define LEDS_PHASE_STEP	1073742UL
+
+/******************************************************************************
+******************** F U N C T I O N   P R O T O T Y P E S ********************
+******************************************************************************/
+
+void leds_hsv_to_rgb(const hsv_s *hsv, rgb_s *rgb);
+void leds_schedule_color(uint16_t minute, rgb_s *rgb);
+uint16_t leds_time_of_day(void);
+
+void leds_fade_to(const rgb_s *rgb, uint16_t ticks);
+void leds_output(uint8_t level);
+
+void leds_animate(uint8_t mode);
+void leds_isr(void);
+void leds_rtc_sync(uint8_t sec);
+
+#endif	/* LEDS_H */
@@ -0,0 +1,80 @@
+/**
+ * @file log.h
+ * @brief Serial log messages with compile-time levels
+ *
+ * Every message has a level and the tag of the module that sends it:
+ *   LOG_W("Input voltage out of range");		// "W/adc: Input voltage..."
+ * The format string goes to FLASH, and the arguments follow uart_printf_P().
+ * Each module defines LOG_TAG (a string literal) before using the macros.
+ *
+ * LOG_LEVEL is selected per build profile in the makefile. Messages above
+ * it expand to nothing: neither the string nor the call is compiled, and
+ * the arguments are not evaluated, so they must not have side effects.
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include "uart.h"
+
+#include <avr/pgmspace.h>
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Log levels
+#define LOG_NONE		0
+#define LOG_ERROR		1		// the system goes down
+#define LOG_WARN		2		// something is wrong, the system goes on
+#define LOG_INFO		3		// boot and power events
+#define LOG_DEBUG		4		// measurements for development
+
+// Default: same output as before the log levels existed
+#ifndef LOG_LEVEL
+#define LOG_LEVEL		LOG_INFO
+#endif
+
+// TRUE if messages of the given level are compiled in. For the code that
+// only produces log output, e.g. if(LOG_ON(LOG_INFO)){...}
+#define LOG_ON(level)	(LOG_LEVEL >= (level))
+
+/******************************************************************************
+******************** F U N C T I O N   P R O T O T Y P E S ********************
+******************************************************************************/
+
+#define LOG_PRINT(l, fmt, ...)	uart_printf_P(PSTR("\n\r" l "/" LOG_TAG ": " fmt), ##__VA_ARGS__)
+#define LOG_NOTHING()			do {} while(0)
+
+#if LOG_ON(LOG_ERROR)
+#define LOG_E(fmt, ...)		LOG_PRINT("E", fmt, ##__VA_ARGS__)
+#else
+#define LOG_E(fmt, ...)		LOG_NOTHING()
+#endif
+
+#if LOG_ON(LOG_WARN)
+#define LOG_W(fmt, ...)		LOG_PRINT("W", fmt, ##__VA_ARGS__)
+#else
+#define LOG_W(fmt, ...)		LOG_NOTHING()
+#endif
+
+#if LOG_ON(LOG_INFO)
+#define LOG_I(fmt, ...)		LOG_PRINT("I", fmt, ##__VA_ARGS__)
+#else
+#define LOG_I(fmt, ...)		LOG_NOTHING()
+#endif
+
+#if LOG_ON(LOG_DEBUG)
+#define LOG_D(fmt, ...)		LOG_PRINT("D", fmt, ##__VA_ARGS__)
+#else
+#define LOG_D(fmt, ...)		LOG_NOTHING()
+#endif
+
+#endif	/* LOG_H */
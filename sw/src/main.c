@@ -21,21 +21,30 @@
 ******************************************************************************/
 
 #include "adc.h"
+#include "buttons.h"
+#include "clock.h"
 #include "config.h"
 #include "debug.h"
+#include "eeprom.h"
+#include "external_interrupt.h"
 #include "init.h"
+#include "leds.h"
+#include "log.h"
 #include "menu_alarm.h"
 #include "menu_time.h"
 #include "menu_user.h"
+#include "remote.h"
+#include "shell.h"
 #include "sleep.h"
+#include "telemetry.h"
 #include "timers.h"
 #include "uart.h"
 #include "util.h"
+#include "watchdog.h"
 
 #include <stdint.h>         /* Standard variable types */
 #include <avr/io.h>         /* Device specific ports/peripherals */ 
 #include <avr/interrupt.h>  /* Global interrupts */
-#include <util/delay.h>     /* Delay utility */
 #include <avr/pgmspace.h>   /* Program Memory reading */
 
 /******************************************************************************
@@ -51,7 +60,7 @@
 */
 
 #define FUSE_BITS_LOW       (FUSE_SUT_CKSEL0 & FUSE_CKDIV8)                             // 0x7E
-#define FUSE_BITS_HIGH      (FUSE_SPIEN & FUSE_EESAVE & FUSE_BOOTSZ1 & FUSE_BOOTSZ0)    // 0xD1
+#define FUSE_BITS_HIGH      (FUSE_SPIEN & FUSE_EESAVE & FUSE_BOOTSZ1 & FUSE_BOOTSZ0 & FUSE_BOOTRST)  // 0xD0
 #define FUSE_BITS_EXTENDED  (FUSE_CFD & FUSE_BODLEVEL0)                                 // 0xF6
 #define LOCK_BITS           0xFF                                                        // No Locks
 
@@ -64,6 +73,13 @@ FUSES = {
 //Place lockbits in a special section (.lock) in the .ELF output file
 LOCKBITS = LOCK_BITS;
 
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Tag of the log messages (see log.h)
+#define LOG_TAG		"main"
+
 
 /******************************************************************************
 *************** G L O B A L   V A R S   D E F I N I T I O N S *****************
@@ -85,7 +101,7 @@ volatile uint8_t loop = FALSE;
 volatile uint8_t sleep_mode = RTC_DISABLE;
 
 // System reset:
-uint8_t system_reset = FALSE;
+volatile uint8_t system_reset = FALSE;
 
 /******************************************************************************
 *************************** M A I N   P R O G R A M ***************************
@@ -93,6 +109,9 @@ uint8_t system_reset = FALSE;
 
 int main(void)
 {
+    // log the cause of the last reset, and the state that was running
+    watchdog_init();
+
     /*
     * During normal execution, inside DISPLAY_TIME, if all three buttons are
     * pushed for DELAY3 milliseconds, execution jumps to RESET label. The
@@ -132,12 +151,23 @@ RESET:
     */
     if(EXT_PWR) {
         sleep_mode = RTC_ENABLE;
-        system_state = SYSTEM_INTRO;
         peripherals_enable();
-        led_blink(3, 40);
-        uart_send_string_p(PSTR("\n\rFirmware Version: "));
-        uart_send_string_p(PSTR(FIRMWARE_DATE));
-        uart_send_string_p(PSTR("\n\r"));
+        boot_log_start();
+#ifdef FAST_BOOT
+        system_state = DISPLAY_TIME;
+#else
+        system_state = SYSTEM_INTRO;
+        // blink the onboard LED 3 times. The general timer keeps running
+        for(uint8_t i = 0; i < 6; i++){
+            RTC_SIGNAL_TOGGLE();
+            timer_base_wait(40);
+        }
+        RTC_SIGNAL_SET(LOW);
+        boot_log(BOOT_BLINK);
+#endif
+        LOG_I("Firmware Version: " FIRMWARE_DATE);
+        watchdog_report();
+        boot_log(BOOT_BANNER);
     } else {
         sleep_mode = RTC_DISABLE;
         system_state = SYSTEM_SLEEP;
@@ -152,6 +182,7 @@ RESET:
     if(system_state != SYSTEM_SLEEP){
         if(adc_factory_test_check())
             system_state = PRODUCTION_TEST;
+        boot_log(BOOT_TEST_CHECK);
     }
 
     /*
@@ -159,16 +190,19 @@ RESET:
     * The following voltages are checked to see wether the voltage ranges are 
     * properly met: V_HV, V_CTL_REG, V_IN
     * If any of these is out of range, inform the situation and jump to RESET.
-    * Delay is necessary mainly to wait for boost output stabilization
+    * Wait for the boost output to settle first
     */
     if((system_state != SYSTEM_SLEEP) && (system_state != PRODUCTION_TEST)){
-        //_delay_ms(1500);
-        _delay_ms(2000);
+        adc_hv_settle();
+        boot_log(BOOT_SETTLE);
         if(!adc_voltages_test()){
-            uart_send_string_p(PSTR("\n\r*** System going down. Please disconnect ***"));  
+            LOG_E("*** System going down. Please disconnect ***");
             system_reset = TRUE;
             goto RESET;
         }
+        // rails are right: keep watching them
+        adc_monitor(ENABLE);
+        boot_log(BOOT_VOLTAGES);
     }
 
     /*-------------------------------------------------------------------------
@@ -232,6 +266,10 @@ RESET:
             // If alarm is triggered: 
             case ALARM_TRIGGERED:
                 alarm_triggered(&system_state); break;
+
+            // Tubes and LEDs driven by frames streamed through the UART
+            case REMOTE_DISPLAY:
+                remote_display(&system_state); break;
             
             // User-accessible test sequence: It tests all the tubes' digits,
             // the RTC 1Hz sync signal, the individual RGB LEDs and the buzzer.
@@ -242,6 +280,11 @@ RESET:
 
             // Jump to a reset state
             case SYSTEM_RESET:
+                if(adc_faults()){
+                    adc_report_faults();
+                    rom_store_fault(adc_faults(), adc_trip_latency());
+                    telemetry_event(TLM_EV_FAULT, adc_faults(), adc_trip_latency());
+                }
                 goto RESET; break;
             default:
                 system_state = DISPLAY_TIME; break;
@@ -280,10 +323,10 @@ ISR(TIMER2_OVF_vect){
 
     if(system_state != PRODUCTION_TEST){
 
-        // update time variables
-        time.sec++;
-        if(time.sec == 60){
-            time.sec = 0;
+        // update time variables, with the crystal drift correction
+        time.sec += timer_rtc_drift(time.sec);
+        if(time.sec >= 60){
+            time.sec -= 60;
             time.min++;
             if(time.min == 60){
                 time.min = 0;
@@ -317,29 +360,43 @@ ISR(TIMER2_OVF_vect){
         time.h_tens = time.hour / 10;
         time.h_units = time.hour % 10;
 
+        // keep the LEDs breathing effect phase-locked to the RTC
+        leds_rtc_sync(time.sec);
+
         // Check alarm match. If true, jump directly to the ALARM_TRIGGERED state,
         // no matter what the clock is doing
-        if(check_alarm()) system_state = ALARM_TRIGGERED;
+        if(check_alarm()){
+            system_state = ALARM_TRIGGERED;
+            telemetry_event(TLM_EV_ALARM, hour_to_24(time.hour, time.day_period), time.min);
+        }
 
         // if power adapter is connected (if not, the MCU is powered be running 
         // with the coin cell battery):
         // - toggle LED
-        // - send time with UART
+        // - send time with UART (text or binary frame), unless streaming
         // if not connected, do not report time nor toggle led.
         if(EXT_PWR) {
             RTC_SIGNAL_TOGGLE();
-            char string[9];
-            string[0] = (char)pgm_read_byte(&bcd_to_ascii[time.h_tens]);
-            string[1] = (char)pgm_read_byte(&bcd_to_ascii[time.h_units]);
-            string[2] = ':';
-            string[3] = (char)pgm_read_byte(&bcd_to_ascii[time.m_tens]);
-            string[4] = (char)pgm_read_byte(&bcd_to_ascii[time.m_units]);
-            string[5] = ':';
-            string[6] = (char)pgm_read_byte(&bcd_to_ascii[time.s_tens]);
-            string[7] = (char)pgm_read_byte(&bcd_to_ascii[time.s_units]);
-            string[8] = '\0';
-            uart_send_string(string);
-            uart_send_string("\n\r");
+            // while streaming frames or echoing bytes, the serial port
+            // belongs to the host tool
+            if((system_state != REMOTE_DISPLAY) && !shell_loopback()){
+                if(telemetry_mode() == TLM_BINARY){
+                    telemetry_time();
+                } else {
+                    char string[9];
+                    string[0] = (char)pgm_read_byte(&bcd_to_ascii[time.h_tens]);
+                    string[1] = (char)pgm_read_byte(&bcd_to_ascii[time.h_units]);
+                    string[2] = ':';
+                    string[3] = (char)pgm_read_byte(&bcd_to_ascii[time.m_tens]);
+                    string[4] = (char)pgm_read_byte(&bcd_to_ascii[time.m_units]);
+                    string[5] = ':';
+                    string[6] = (char)pgm_read_byte(&bcd_to_ascii[time.s_tens]);
+                    string[7] = (char)pgm_read_byte(&bcd_to_ascii[time.s_units]);
+                    string[8] = '\0';
+                    uart_send_string(string);
+                    uart_send_string("\n\r");
+                }
+            }
         } else {
             RTC_SIGNAL_SET(LOW);
         }   
@@ -352,9 +409,13 @@ ISR(TIMER2_OVF_vect){
 /*
 * TIMER 3 is used as a general purpose counter. Interrupts are generated every
 * 1ms and this time base is used for multiple purposes:
-* - loop flag is set in every execution
+* - loop flag is set in every execution. The watchdog is fed if the system
+*   state loop took the previous tick
 * - Nixie tubes multiplexing routine is handled based on an internal counter
 * - Nixie tubes fading routine is handled based on an internal counter
+* - LEDs animator is advanced
+* - Buttons are sampled and debounced
+* - ADC conversions are started
 */
 ISR(TIMER3_COMPA_vect){
 
@@ -363,8 +424,11 @@ ISR(TIMER3_COMPA_vect){
                                     // 0: fully off; 5: fully on
     static uint16_t cnt = 0;        // general purpose counter
 
-    // execute main loop every 1ms.
+    // execute main loop every 1ms. A loop flag still set means the system
+    // state is stuck: stop feeding the watchdog
+    if(!loop) watchdog_tick(system_state);
     loop = TRUE;
+    base_ms++;
 
     if(system_state != PRODUCTION_TEST){
         // multiplex tubes' anode every 5ms. Independent of fading level
@@ -397,6 +461,13 @@ ISR(TIMER3_COMPA_vect){
         // fade level counter
         n_fade++;
         if(n_fade > 5) n_fade = 1;
+
+        // LEDs breathing and color fades
+        leds_isr();
+        // buttons debounce and events
+        buttons_isr();
+        // next conversion of the ADC background sampler
+        adc_tick();
     }
 }
 
@@ -404,33 +475,13 @@ ISR(TIMER3_COMPA_vect){
                     E X T E R N A L   I N T E R R U P T S
 -----------------------------------------------------------------------------*/
 /*
-* EXTERNAL INTERRUPTS are active for two sources: buttons and external power
-* adapter connection.
-* - When buttons are pressed, btnXYZ.query flag is set and the buttons are
-*   polled to determine its state.
-* - When EXT_PWR pin triggers the ISR, the power adapter was either removed
-*   or plugged. Thus, check EXT_PWR level and decide whether going to sleep
-*   or keep normal execution.
+* EXTERNAL INTERRUPTS are active for the external power adapter connection:
+* When EXT_PWR pin triggers the ISR, the power adapter was either removed
+* or plugged. Thus, check EXT_PWR level and decide whether going to sleep
+* or keep normal execution.
+* Buttons are sampled by the general timer ISR, not by pin change interrupts
 */
 
-/*===========================================================================*/
-/* 
-* buttons     
-* BTN_X       - PB5 - PCINT13 | -> PCI1
-* BTN_Y       - PB6 - PCINT14 | -> PCI1
-* BTN_Z       - PB7 - PCINT15 | -> PCI1 
-*/
-ISR(PCINT1_vect)
-{
-    if((!(btnX.check)()) && (!(btnX.lock))){
-        btnX.query = TRUE;
-    } else if((!(btnY.check)()) && (!(btnY.lock))){
-        btnY.query = TRUE;
-    } else if((!(btnZ.check)()) && (!(btnZ.lock))){
-        btnZ.query = TRUE;
-    }
-}
-
 /*===========================================================================*/
 /* 
 * External power
@@ -440,8 +491,64 @@ ISR(PCINT1_vect)
 ISR(PCINT2_vect)
 {
     if(!EXT_PWR){
+        // 16MHz (animations) is out of spec as VCC drops: back to 2MHz first
+        clock_power_loss();
+        // save the time first, while there's still some power left. Only if
+        // the clock was running
+        if(system_state != SYSTEM_SLEEP) rom_journal_capture();
         // Boost is automatically powered off (12V removed)
         RTC_SIGNAL_SET(LOW);          // Dont use RTC LED
         system_state = SYSTEM_SLEEP;  // GO TO SLEEP !!!
     }
-}
\ No newline at end of file
+}
+
+/*===========================================================================*/
+/*
+* EEPROM ready
+* Triggers while the EEPROM is not busy and there are bytes waiting in the
+* write queue. Writes the next one.
+*/
+ISR(EE_READY_vect)
+{
+    rom_isr();
+}
+
+/*===========================================================================*/
+/*
+* ADC conversion complete
+* Stores the reading of the background sampler. If a rail has been out of
+* its window for a while, go down as the boot voltage check does.
+*/
+ISR(ADC_vect)
+{
+    if(adc_isr()){
+        // on a high voltage trip the boost is already off: blank the tubes
+        // right away, don't wait for the reset
+        if(adc_faults() & ADC_FAULT_HV_TRIP){
+            display.set = OFF;
+            set_digit(BLANK);
+        }
+        system_reset = TRUE;
+        system_state = SYSTEM_RESET;
+    }
+}
+
+/*===========================================================================*/
+/*
+* UART receive complete
+* Queues the received char for the command shell
+*/
+ISR(USART2_RX_vect)
+{
+    uart_rx_isr();
+}
+
+/*===========================================================================*/
+/*
+* UART data register empty
+* Sends the next char of the transmit ring
+*/
+ISR(USART2_UDRE_vect)
+{
+    uart_tx_isr();
+}
@@ -14,6 +14,7 @@
 ******************************************************************************/
 
 #include "menu_alarm.h"
+#include "buttons.h"
 #include "buzzer.h"
 #include "config.h"
 #include "menu_time.h"
@@ -22,6 +23,7 @@
 #include "util.h"
 
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include <stdint.h>
 
 /******************************************************************************
@@ -47,6 +49,7 @@ typedef struct {
 ******************************************************************************/
 
 static void increment_alarm(uint8_t what);
+static void increment_alarm_tens(uint8_t what);
 static void change_theme(uint8_t dir);
 static void init_snooze_time(snooze_s *p1, snooze_s *p2);
 static uint8_t check_snooze_time(snooze_s *p);
@@ -77,6 +80,7 @@ void alarm_init(void)
 */
 void set_alarm_active(volatile state_t *state)
 {
+	uint8_t ev;
 	uint16_t count = 0;
 	uint8_t toggle = 0;
 
@@ -89,7 +93,8 @@ void set_alarm_active(volatile state_t *state)
 	display.d2 = BLANK;
 	display.d3 = BLANK;
 	timer_leds_set(ENABLE, 0, 50, 50);
-	
+	buttons_flush();
+
 	/* 
 	* INFINITE LOOP
 	*/
@@ -106,31 +111,24 @@ void set_alarm_active(volatile state_t *state)
 		else display.set = OFF;
 
 		/* 
-		* BUTTONS check: Buttons are detected using an ISR which sets btnXYZ
-	    * flags. Once set, the rest of the detection and debounce routine is
-	    * handled within buttons_check(), based on the 1ms execution period of
-	    * the main infinite loop
-	    *
-	    * BUTTONS actions:
-		* - executed according to the buttons state flags
+		* BUTTONS events: Buttons are sampled and debounced by the 1ms timer
+		* ISR, which queues the button events (see buttons.c). One event is
+		* consumed per loop execution.
+		*
+		* BUTTONS actions:
+		* - executed according to the received event
 		*/
-		if(btnX.query) buttons_check(&btnX);
-	    if(btnY.query) buttons_check(&btnY);
-	    if(btnZ.query) buttons_check(&btnZ);
+		ev = buttons_get();
 		// If X pressed, return to the menu
-		if((btnX.action) && (btnX.state == BTN_RELEASED) && (!btnX.delay1)){
-			btnX.action = FALSE;
+		if(ev == BTN_CLICK(BTN_X)){
 			*state = DISPLAY_MENU;
 		}
 		// If X pressed and hold, return to the time display
-		if((btnX.action) && (btnX.delay3)){
+		if(ev == (BTN_EV_LONG | BTN_X)){
 			*state = DISPLAY_TIME;
-			btnX.action = FALSE;
 		}
 		// If Y or Z pressed, toggle the alarm state (enable/disable)
-		if(((btnY.action) && (!btnY.delay1)) || ((btnZ.action) && (!btnZ.delay1))){
-			btnY.action = FALSE;
-			btnZ.action = FALSE;
+		if((ev == (BTN_EV_PRESS | BTN_Y)) || (ev == (BTN_EV_PRESS | BTN_Z))){
 			alarm.active ^= 1;
 			count = 0;
 		}
@@ -173,6 +171,7 @@ void set_alarm_active(volatile state_t *state)
 */
 void set_alarm(volatile state_t *state)
 {
+	uint8_t ev;
 	uint16_t count = 0;
 	uint8_t toggle = 0;
 	uint8_t selection = 1;
@@ -185,6 +184,8 @@ void set_alarm(volatile state_t *state)
 	display.fade_level[3] = 5;
 	if(alarm.day_period == PERIOD_AM) timer_leds_set(ENABLE, 0, 150, 0);
 	else if(alarm.day_period == PERIOD_PM) timer_leds_set(ENABLE, 0, 0, 150);
+	buttons_flush();
+	buttons_repeat_time(selection);
 
 	/*
 	* INFINITE LOOP
@@ -198,7 +199,7 @@ void set_alarm(volatile state_t *state)
 		* 	is kept pushed, blinking stops and fast increment occurs
 		*/
 		if(mode == DISP_MODE_0){
-			if((toggle) || (btnZ.state == BTN_PUSHED)){
+			if((toggle) || (buttons_state() & BTN_Z)){
 				display.d1 = alarm.h_tens;
 				display.d2 = alarm.h_units;
 				display.d3 = alarm.m_tens;
@@ -234,55 +235,39 @@ void set_alarm(volatile state_t *state)
 		}
 
 		/* 
-		* BUTTONS check: Buttons are detected using an ISR which sets btnXYZ
-	    * flags. Once set, the rest of the detection and debounce routine is
-	    * handled within buttons_check(), based on the 1ms execution period of
-	    * the main infinite loop
-	    *
-	    * BUTTONS actions:
-		* - executed according to the buttons state flags
+		* BUTTONS events: Buttons are sampled and debounced by the 1ms timer
+		* ISR, which queues the button events (see buttons.c). One event is
+		* consumed per loop execution.
+		*
+		* BUTTONS actions:
+		* - executed according to the received event
 		*/
-		if(btnX.query) buttons_check(&btnX);
-	    if(btnY.query) buttons_check(&btnY);
-	    if(btnZ.query) buttons_check(&btnZ);
+		ev = buttons_get();
 		// If X pressed, return to menu
-		if((btnX.action) && (btnX.state == BTN_RELEASED) && (!btnX.delay1)){
-			btnX.action = FALSE;
+		if(ev == BTN_CLICK(BTN_X)){
 			*state = DISPLAY_MENU;
 		}
 		// If X pressed and hold, return to display the time
-		if((btnX.action) && (btnX.delay3)){
-			btnX.action = FALSE;
+		if(ev == (BTN_EV_LONG | BTN_X)){
 			*state = DISPLAY_TIME;
 		}
 		// If Y pressed, toggle selection between hours and minutes
-		if((btnY.action) && (!btnY.delay1)){
-			btnY.action = FALSE;
+		if(ev == (BTN_EV_PRESS | BTN_Y)){
 			selection ^= 1;
+			buttons_repeat_time(selection);
 			count = 0;
 		}
 		// If Z pressed, increment the selected quantity. If pressed and hold,
-		// fast increment of the quantity
-		if(btnZ.action){
-			if(btnZ.state == BTN_RELEASED){
-				if(selection) {
-					increment_alarm(INC_HOUR);
-					update_time_variables();
-				} else {
-					increment_alarm(INC_MIN);
-					update_time_variables();
-				}
-				btnZ.action = FALSE;
-			} else if((btnZ.delay1) && (btnZ.delay2)){
-				btnZ.delay2 = FALSE;
-				if(selection){
-					increment_alarm(INC_HOUR);
-					update_time_variables();
-				} else {
-					increment_alarm(INC_MIN);
-					update_time_variables();
-				}
-			}
+		// increment it faster and faster; minutes jump by tens at the end
+		if((ev == (BTN_EV_PRESS | BTN_Z)) || (ev == (BTN_EV_REPEAT | BTN_Z))){
+			if(selection) increment_alarm(INC_HOUR);
+			else increment_alarm(INC_MIN);
+			update_time_variables();
+			count = 0;
+		}
+		if(ev == (BTN_EV_REPEAT | BTN_EV_FAST | BTN_Z)){
+			increment_alarm_tens(INC_MIN);
+			update_time_variables();
 			count = 0;
 		}
 
@@ -328,6 +313,7 @@ void set_alarm(volatile state_t *state)
 */
 void alarm_triggered(volatile state_t *state)
 {
+	uint8_t ev;
 	uint16_t count = 0;
 	uint16_t count2 = 0;
 	uint8_t toggle = 0;
@@ -343,6 +329,7 @@ void alarm_triggered(volatile state_t *state)
 	display.fade_level[2] = 5;
 	display.fade_level[3] = 5;
 	init_snooze_time(&snooze_time_1, &snooze_time_2);
+	buttons_flush();
 
 	/*
 	* INFINITE LOOP
@@ -369,17 +356,14 @@ void alarm_triggered(volatile state_t *state)
 		display.d4 = time.m_units;
 
 		/* 
-		* BUTTONS check: Buttons are detected using an ISR which sets btnXYZ
-	    * flags. Once set, the rest of the detection and debounce routine is
-	    * handled within buttons_check(), based on the 1ms execution period of
-	    * the main infinite loop
-	    *
-	    * BUTTONS actions:
-		* - executed according to the buttons state flags
+		* BUTTONS events: Buttons are sampled and debounced by the 1ms timer
+		* ISR, which queues the button events (see buttons.c). One event is
+		* consumed per loop execution.
+		*
+		* BUTTONS actions:
+		* - executed according to the received event
 		*/
-		if(btnX.query) buttons_check(&btnX);
-	    if(btnY.query) buttons_check(&btnY);
-	    if(btnZ.query) buttons_check(&btnZ);
+		ev = buttons_get();
 
 		/* 
 		* The alarm and snooze time are handled like a pseudo states-machine.
@@ -404,10 +388,7 @@ void alarm_triggered(volatile state_t *state)
 			// Alarm triggered. Wait for a button press or 1 minute elapsed
 			case 0:
 				count2++;
-				if((count2 >= 60000) || (btnX.action && !btnX.delay3) || (btnY.action && !btnY.delay3) || (btnZ.action && !btnZ.delay3)){
-				   	btnX.action = FALSE;
-					btnY.action = FALSE;
-					btnZ.action = FALSE;
+				if((count2 >= 60000) || (BTN_EV_TYPE(ev) == BTN_EV_PRESS)){
 					count2 = 0;
 					buzz_state = DISABLE;
 					if((snooze == 0) || (snooze == 1)){
@@ -439,10 +420,7 @@ void alarm_triggered(volatile state_t *state)
 						}
 					}
 				}
-				if((btnX.action && !btnX.delay3) || (btnY.action && !btnY.delay3) || (btnZ.action && !btnZ.delay3)){
-					btnX.action = FALSE;
-					btnY.action = FALSE;
-					btnZ.action = FALSE;
+				if(BTN_EV_TYPE(ev) == BTN_EV_PRESS){
 					alarm.triggered = FALSE;
 					*state = DISPLAY_TIME;
 					buzz_state = DISABLE;
@@ -491,6 +469,7 @@ void alarm_triggered(volatile state_t *state)
 */
 void set_alarm_theme(volatile state_t *state)
 {
+	uint8_t ev;
 	uint16_t count = 0;
 	uint8_t toggle = 0;
 
@@ -503,7 +482,8 @@ void set_alarm_theme(volatile state_t *state)
 	display.d2 = BLANK;
 	display.d3 = BLANK;
 	timer_leds_set(ENABLE, 50, 50, 50);
-	
+	buttons_flush();
+
 	/*
 	* INFINITE LOOP
 	*/
@@ -530,38 +510,31 @@ void set_alarm_theme(volatile state_t *state)
 		buzzer_music(alarm.theme, ENABLE);
 		
 		/* 
-		* BUTTONS check: Buttons are detected using an ISR which sets btnXYZ
-	    * flags. Once set, the rest of the detection and debounce routine is
-	    * handled within buttons_check(), based on the 1ms execution period of
-	    * the main infinite loop
-	    *
-	    * BUTTONS actions:
-		* - executed according to the buttons state flags
+		* BUTTONS events: Buttons are sampled and debounced by the 1ms timer
+		* ISR, which queues the button events (see buttons.c). One event is
+		* consumed per loop execution.
+		*
+		* BUTTONS actions:
+		* - executed according to the received event
 		*/
-		if(btnX.query) buttons_check(&btnX);
-	    if(btnY.query) buttons_check(&btnY);
-	    if(btnZ.query) buttons_check(&btnZ);
+		ev = buttons_get();
 		// If Z pressed, switch to the previous tone
-		if((btnZ.action) && (!btnZ.delay1)){
-			btnZ.action = FALSE;
+		if(ev == (BTN_EV_PRESS | BTN_Z)){
 			change_theme(DOWN);
 			count = 0;
 		}
 		// If Y pressed, switch to the next tone
-		if((btnY.action) && (!btnY.delay1)){
-			btnY.action = FALSE;
+		if(ev == (BTN_EV_PRESS | BTN_Y)){
 			change_theme(UP);
 			count = 0;
 		}
 		// If X pressed, return to the menu
-		if((btnX.action) && (btnX.state == BTN_RELEASED) && (!btnX.delay1)){
-			btnX.action = FALSE;
+		if(ev == BTN_CLICK(BTN_X)){
 			*state = DISPLAY_MENU;
 			buzzer_music(alarm.theme, DISABLE);
 		}
 		// If X pressed and hold, return to display the time 
-		if((btnX.action) && (btnX.delay3)){
-			btnX.action = FALSE;
+		if(ev == (BTN_EV_LONG | BTN_X)){
 			*state = DISPLAY_TIME;
 			buzzer_music(alarm.theme, DISABLE);
 		}
@@ -640,6 +613,17 @@ static void increment_alarm(uint8_t what)
 	else if(alarm.day_period == PERIOD_PM) timer_leds_set(ENABLE, 0, 0, 150);
 }
 
+/*===========================================================================*/
+/*
+* Increments minutes or seconds up to the next multiple of 10
+*/
+static void increment_alarm_tens(uint8_t what)
+{
+	do {
+		increment_alarm(what);
+	} while(((what == INC_MIN) ? alarm.min : alarm.sec) % 10);
+}
+
 /*===========================================================================*/
 static void change_theme(uint8_t dir)
 {
@@ -14,10 +14,16 @@
 ******************************************************************************/
 
 #include "menu_time.h"
+#include "buttons.h"
 #include "buzzer.h"
+#include "clock.h"
 #include "config.h"
-#include "math.h"
+#include "eeprom.h"
+#include "init.h"
+#include "leds.h"
 #include "menu_alarm.h"
+#include "shell.h"
+#include "telemetry.h"
 #include "timers.h"
 #include "uart.h"
 #include "util.h"
@@ -36,18 +42,6 @@ time_s time;
 ******************* C O N S T A N T   D E F I N I T I O N S *******************
 ******************************************************************************/
 
-// LEDs behavior is one of three forms:
-// - Breathing: LEDs PWM is varied quadratically with a period of 4 seconds
-// - Steady: LEDs PWM do not change.
-// - Off: LEDs PWM is disabled
-#define LEDS_BREATHE	0xBB
-#define LEDS_STEADY		0xEE
-#define LEDS_OFF		0xFF
-
-#define LED_RED 	1
-#define LED_GREEN 	2
-#define LED_BLUE 	3
-
 // Vectors used for the transitions in different display animations
 static const uint8_t animation_3d_t1[] PROGMEM = {
 	3,8,9,4,0,5,7,2,6,1,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF
@@ -62,31 +56,13 @@ static const uint8_t positions_3d[] PROGMEM = {
 	4,9,7,0,3,5,8,6,1,2,1,6,8,5,3,0,7,9
 };
 
-// LEDs PWM values for breathing effect
-// 250 values. This seqeuence resembles a quadratic function with a range from
-// 0 to 254. Used during display_time() for LEDs effects.
-static const uint8_t led_pwm[] PROGMEM = {
-	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,2,2,2,2,2,3,3,3,3,4,4,4,5,5,
-	5,5,6,6,6,7,7,7,8,8,9,9,9,10,10,11,11,11,12,12,13,13,14,14,15,15,16,16,17,
-	17,18,18,19,20,20,21,21,22,23,23,24,24,25,26,26,27,28,28,29,30,31,31,32,33,
-	33,34,35,36,36,37,38,39,40,40,41,42,43,44,45,46,46,47,48,49,50,51,52,53,54,
-	55,56,57,58,58,59,60,61,62,64,65,66,67,68,69,70,71,72,73,74,75,76,78,79,80,
-	81,82,83,84,86,87,88,89,90,92,93,94,95,97,98,99,100,102,103,104,106,107,
-	108,110,111,112,114,115,117,118,119,121,122,124,125,126,128,129,131,132,
-	134,135,137,138,140,141,143,144,146,147,149,151,152,154,155,157,158,160,
-	162,163,165,167,168,170,172,173,175,177,178,180,182,184,185,187,189,191,
-	192,194,196,198,200,201,203,205,207,209,211,212,214,216,218,220,222,224,
-	226,228,230,232,234,235,237,239,241,243,245,247,249,251,254
-};
-
 /******************************************************************************
 ******************* F U N C T I O N   D E F I N I T I O N S *******************
 ******************************************************************************/
 
 static void increment_time(uint8_t what);
+static void increment_time_tens(uint8_t what);
 static void change_hour_mode(uint8_t mode);
-//static uint8_t led_pwm_value(uint8_t led, uint16_t v, uint8_t day_period);
-static uint8_t led_pwm_value(uint8_t led, uint16_t v);
 
 /*===========================================================================*/
 void time_init(void)
@@ -104,6 +80,7 @@ void time_init(void)
 	time.update = FALSE;
 	time.hour_mode = MODE_12H;
 	time.day_period = PERIOD_AM;
+	time.stale = FALSE;
 }
 
 /*===========================================================================*/
@@ -126,17 +103,27 @@ void display_time(volatile state_t *state)
 	uint8_t display_mode = DISP_MODE_8;
 	uint8_t temp[] = {0,0,0,0};		// temporal values
 	// leds-related variables
-	uint8_t leds_cnt_up = FALSE;
-	uint16_t leds_count = 0;
 	uint8_t leds_mode = LEDS_BREATHE;
+	uint8_t leds_min = time.min;
+	rgb_s leds_color;
+	// buttons-related variables
+	uint8_t ev;
+	// settings-related variables
+	uint16_t rom_delay = ROM_SETTINGS_DELAY;
+	uint8_t journal_min = time.min;
+	uint8_t status_sec = time.sec;
 	
-	timer_leds_set(ENABLE, 0, 0, 0);
+	leds_schedule_color(leds_time_of_day(), &leds_color);
+	leds_fade_to(&leds_color, 0);
 	display.set = ON;
 	display.fade_level[0] = 5;
 	display.fade_level[1] = 5;
 	display.fade_level[2] = 5;
 	display.fade_level[3] = 5;
-	
+	buttons_flush();
+	shell_init();
+	boot_log(BOOT_DISPLAY);
+
 	/*
 	* INFINITE LOOP
 	*/
@@ -144,64 +131,31 @@ void display_time(volatile state_t *state)
 
 		/*
 		* LEDs SEQUENCES
-		* - breathing sequence: leds are synced to the RTC by means of the 
-		*   time.update flag.
+		* - the LEDs animator runs in the 1ms timer ISR, phase-locked to the
+		*   RTC. Here, only its mode and target color are selected.
+		* - LEDs color follows the day palette. A new color is computed once
+		*   per minute and reached through a smooth fade.
 		* If display.set is ON, enable LEDs; else, disable them
 		* If DISP_MODE_7 is selected, it means the clock is displaying the alarm
 		* and LEDs show the alarm.day_period color (either green or blue)
 		*/
 		if(display.set == ON){
 			if(display_mode != DISP_MODE_7){
-				// LEDs breathing sequence has a period of 4 seconds: 2 seconds
-				// increasing intensity and 2 seconds decreasing intensity. leds_count
-				// may range from 0 to 1999, but the range is limited from 5 to 1995
-				// to account for possible delays in other routines (other routines 
-				// may take more than a millisecond to execute)
-				if(leds_mode == LEDS_BREATHE){
-					if(leds_cnt_up){
-						if(leds_count < 1999) leds_count++;
-						else leds_count = 1999;
-					} else {
-						if(leds_count > 0) leds_count--;
-						else leds_count = 0;
-					}
-					
-					// sync leds_count with the general counter (T = 1ms)
-					if(time.update){
-						time.update = FALSE;
-						if((leds_cnt_up) && (leds_count > 1000) && (time.sec % 2)){
-							leds_cnt_up = FALSE;
-							leds_count = 1999;
-						} else if((!leds_cnt_up) && (leds_count < 1000) && (time.sec % 2)){
-							leds_cnt_up = TRUE;
-							leds_count = 0;
-						}
-					}
-
-					// LEDs update value every 5ms, not every ms (LEDs value does not change every ms)
-					if(!(leds_count % 5)){
-						uint8_t led_r = 0, led_g = 0, led_b = 0;
-						led_r = led_pwm_value(LED_RED, leds_count);
-						led_g = led_pwm_value(LED_GREEN, leds_count);
-						led_b = led_pwm_value(LED_BLUE, leds_count);
-						timer_leds_set(ENABLE, led_r, led_g, led_b);
-					}
-				} else if(leds_mode == LEDS_STEADY){
-					if(time.day_period == PERIOD_AM) 
-						timer_leds_set(ENABLE, 50, 30, 0);
-					else if(time.day_period == PERIOD_PM)
-						timer_leds_set(ENABLE, 20, 20, 65);
-				} else if(leds_mode == LEDS_OFF){
-					timer_leds_set(DISABLE, 0, 0, 0);
+				if(time.min != leds_min){
+					leds_min = time.min;
+					leds_schedule_color(leds_time_of_day(), &leds_color);
+					leds_fade_to(&leds_color, LEDS_FADE_TICKS);
 				}
+				leds_animate(leds_mode);
 			} else {
+				leds_animate(LEDS_MANUAL);
 				if(alarm.day_period == PERIOD_AM) 
 					timer_leds_set(ENABLE, 0, 150, 0);
 				else if(alarm.day_period == PERIOD_PM) 
 					timer_leds_set(ENABLE, 0, 0, 150);
 			}	
 		} else {
-			timer_leds_set(DISABLE, 0, 0, 0);
+			leds_animate(LEDS_OFF);
 		}
 		
 		/* 
@@ -241,10 +195,18 @@ void display_time(volatile state_t *state)
 			case DISP_MODE_0:				
 				
 				if(time.sec != 0) transition_triggered = FALSE;
-				display.d1 = time.h_tens;
-				display.d2 = time.h_units;	
-				display.d3 = time.m_tens;
-				display.d4 = time.m_units;
+				if(time.stale && (time.sec & 0x01)){
+					// time restored after a power loss: blink until it's set
+					display.d1 = BLANK;
+					display.d2 = BLANK;
+					display.d3 = BLANK;
+					display.d4 = BLANK;
+				} else {
+					display.d1 = time.h_tens;
+					display.d2 = time.h_units;	
+					display.d3 = time.m_tens;
+					display.d4 = time.m_units;
+				}
 				break;
 
 			// --------------------------------------------------------------------
@@ -694,20 +656,16 @@ void display_time(volatile state_t *state)
 		}
 		
 		/* 
-		* BUTTONS check: Buttons are detected using an ISR which sets btnXYZ
-	    * flags. Once set, the rest of the detection and debounce routine is
-	    * handled within buttons_check(), based on the 1ms execution period of
-	    * the main infinite loop
-	    *
-	    * BUTTONS actions:
-		* - executed according to the buttons state flags
+		* BUTTONS events: Buttons are sampled and debounced by the 1ms timer
+		* ISR, which queues the button events (see buttons.c). One event is
+		* consumed per loop execution.
+		*
+		* BUTTONS actions:
+		* - executed according to the received event
 		*/
-		if(btnX.query) buttons_check(&btnX);
-	    if(btnY.query) buttons_check(&btnY);
-	    if(btnZ.query) buttons_check(&btnZ);
+		ev = buttons_get();
 		// If button X pushed for 2 seconds, go to DISPLAY_MENU
-		if((btnX.action) && (btnX.delay3) && (!btnY.action) && (!btnZ.action)){
-			btnX.action = FALSE;
+		if(ev == (BTN_EV_LONG | BTN_X)){
 			if(display.set){
 				if(display_mode == DISP_MODE_0){
 					display_mode = DISP_MODE_9;
@@ -717,8 +675,7 @@ void display_time(volatile state_t *state)
 			}
 		}
 		// if X pushed, just go to intro mode
-		if((btnX.action) && (btnX.state == BTN_RELEASED) && (!btnX.delay1)){
-			btnX.action = FALSE;
+		if(ev == BTN_CLICK(BTN_X)){
 			if(display.set) {
 				if(display_mode == DISP_MODE_0)
 					*state = SYSTEM_INTRO;
@@ -727,8 +684,7 @@ void display_time(volatile state_t *state)
 			}
 		}
 		// if Z pushed, change LEDs behavior
-		if((btnZ.action) && (btnZ.state == BTN_RELEASED) && (!btnZ.delay1)){
-			btnZ.action = FALSE;
+		if(ev == BTN_CLICK(BTN_Z)){
 			if(display.set){
 				if(leds_mode == LEDS_BREATHE) {
 					leds_mode = LEDS_STEADY;
@@ -736,16 +692,13 @@ void display_time(volatile state_t *state)
 					leds_mode = LEDS_OFF;
 				} else if(leds_mode == LEDS_OFF) {
 					leds_mode = LEDS_BREATHE;
-					leds_count = 0;
-					leds_cnt_up = TRUE;
 				}
 			} else {
 				display.set = ON;
 			}
 		}
 		// if Y pushed, show alarm
-		if((btnY.action) && (btnY.state == BTN_RELEASED) && (!btnY.delay1)){
-			btnY.action = FALSE;
+		if(ev == BTN_CLICK(BTN_Y)){
 			if(display.set) {
 				if(display_mode == DISP_MODE_0)
 					display_mode = DISP_MODE_7;
@@ -754,20 +707,56 @@ void display_time(volatile state_t *state)
 			}
 		}
 		// if Y pushed for 2 seconds, display is off
-		if((btnY.action) && (btnY.delay3) && (!btnX.action) && (!btnZ.action)){
-			btnY.action = FALSE;
+		if(ev == (BTN_EV_LONG | BTN_Y)){
 			display.set = OFF;
 			buzzer_beep();
 		}
-		// IF ALL THREE BUTTONS PRESSED DURING DELAY3, RESET SYSTEM AND GO TO SLEEP
-		if((btnX.action) && (btnX.delay3) && (btnY.action) && (btnY.delay3) && (btnZ.action) && (btnZ.delay3)){
-			btnX.action = FALSE;
-			btnY.action = FALSE;
-			btnZ.action = FALSE;
+		// if X and Z held for 2 seconds, send the boot log
+		if(ev == (BTN_EV_CHORD | BTN_X | BTN_Z))
+			boot_log_dump();
+		// if X and Y held for 2 seconds, send the loop load statistics
+		if(ev == (BTN_EV_CHORD | BTN_X | BTN_Y))
+			clock_report();
+		// IF ALL THREE BUTTONS HELD FOR 2 SECONDS, RESET SYSTEM AND GO TO SLEEP
+		if(ev == (BTN_EV_CHORD | BTN_XYZ)){
 			display.set = OFF;
 			system_reset = TRUE;
+			rom_settings_clear();
+			rom_journal_clear();
 			*state = SYSTEM_RESET;
 		}
+		/*
+		* SERIAL COMMANDS: received chars are queued by the UART RX ISR
+		*/
+		shell_poll(state);
+		timer_rtc_slew_run();
+		/*
+		* USER SETTINGS
+		* Changes made in the menus are stored once the clock has been
+		* displaying the time for ROM_SETTINGS_DELAY. Several trips to the
+		* menus in a row end up in a single EEPROM write.
+		*/
+		if(rom_delay){
+			rom_delay--;
+			if(!rom_delay) rom_settings_save();
+		}
+		/*
+		* TIME JOURNAL
+		* Checkpoint every ROM_JOURNAL_PERIOD minutes, in case the power loss
+		* capture doesn't make it
+		*/
+		if(time.min != journal_min){
+			journal_min = time.min;
+			if(!(time.min % ROM_JOURNAL_PERIOD)) rom_journal_checkpoint();
+		}
+		/*
+		* TELEMETRY: rail voltages and loop load every TLM_STATUS_PERIOD
+		* seconds (binary mode only)
+		*/
+		if(time.sec != status_sec){
+			status_sec = time.sec;
+			if(!(time.sec % TLM_STATUS_PERIOD) && !shell_loopback()) telemetry_status();
+		}
 		/* 
 		* 	GENERAL FUNCTION COUNTER
 		*/
@@ -780,6 +769,13 @@ void display_time(volatile state_t *state)
 		* use of atomic operations. "loop" flag is set every 1ms by a timer
 		* whose ISR is enabled to produce interrupts every 1ms
 		*/
+		/*
+		* CPU CLOCK: animations run at 16MHz, the steady time at 2MHz
+		*/
+		clock_load();
+		if(display_mode == DISP_MODE_0) clock_request(CLK_SLOW);
+		else clock_request(CLK_FAST);
+
 		sei();
 		// Wait for the next ms.
 		while(!loop);
@@ -790,6 +786,10 @@ void display_time(volatile state_t *state)
 			break;
 
 	}	/* INFINITE LOOP */
+
+	// other states set the LEDs by themselves
+	leds_animate(LEDS_MANUAL);
+	clock_set(CLK_SLOW);
 }
 
 /*===========================================================================*/
@@ -801,6 +801,7 @@ void display_time(volatile state_t *state)
 */
 void set_time(volatile state_t *state)
 {
+	uint8_t ev;
 	uint16_t count = 0;
 	uint8_t toggle = 0;
 	uint8_t selection = 1;
@@ -809,7 +810,9 @@ void set_time(volatile state_t *state)
 	display.set = ON;
 	if(time.day_period == PERIOD_AM) timer_leds_set(ENABLE, 50, 30, 0);
 	else if(time.day_period == PERIOD_PM) timer_leds_set(ENABLE, 20, 20, 65);
-	
+	buttons_flush();
+	buttons_repeat_time(selection);
+
 	/*
 	* INFINITE LOOP
 	*/
@@ -845,7 +848,7 @@ void set_time(volatile state_t *state)
 				break;
 
 			case DISP_MODE_1:
-				if((toggle) || (btnZ.state == BTN_PUSHED)){
+				if((toggle) || (buttons_state() & BTN_Z)){
 					display.d1 = time.h_tens;
 					display.d2 = time.h_units;
 					display.d3 = time.m_tens;
@@ -862,7 +865,7 @@ void set_time(volatile state_t *state)
 				break;
 
 			case DISP_MODE_2:
-				if((toggle) || (btnZ.state == BTN_PUSHED)){
+				if((toggle) || (buttons_state() & BTN_Z)){
 					display.d1 = time.m_tens;
 					display.d2 = time.m_units;
 					display.d3 = time.s_tens;
@@ -880,71 +883,58 @@ void set_time(volatile state_t *state)
 		}	
 
 		/* 
-		* BUTTONS check: Buttons are detected using an ISR which sets btnXYZ
-	    * flags. Once set, the rest of the detection and debounce routine is
-	    * handled within buttons_check(), based on the 1ms execution period of
-	    * the main infinite loop
-	    *
-	    * BUTTONS actions:
-		* - executed according to the buttons state flags
+		* BUTTONS events: Buttons are sampled and debounced by the 1ms timer
+		* ISR, which queues the button events (see buttons.c). One event is
+		* consumed per loop execution.
+		*
+		* BUTTONS actions:
+		* - executed according to the received event
 		*/
-		if(btnX.query) buttons_check(&btnX);
-	    if(btnY.query) buttons_check(&btnY);
-	    if(btnZ.query) buttons_check(&btnZ);
+		ev = buttons_get();
 		// If X is pressed, return to the menu
-		if((btnX.action) && (btnX.state == BTN_RELEASED) && (!btnX.delay1)){
-			btnX.action = FALSE;
+		if(ev == BTN_CLICK(BTN_X)){
 			*state = DISPLAY_MENU;
 		}
-		// If X is pressed for delay3 ms, return to display the time
-		if((btnX.action) && (btnX.delay3)){
+		// If X is pressed for 2 seconds, return to display the time
+		if(ev == (BTN_EV_LONG | BTN_X)){
 			*state = DISPLAY_TIME;
-			btnX.action = FALSE;
 		}
 		// If Y is pressed, toggle hours/minutes selection
-		if((btnY.action) && (btnY.state == BTN_RELEASED) && (!btnY.delay1)){
-			btnY.action = FALSE;
+		if(ev == BTN_CLICK(BTN_Y)){
 			selection ^= 1;
+			buttons_repeat_time(selection && (display_mode != DISP_MODE_2));
 			count = 0;
 		}
-		// If Y button pressed for delay3 ms, show minutes and seconds, not hours.
+		// If Y button pressed for 2 seconds, show minutes and seconds, not hours.
 		// This would be a "hidden" feature, used for calibration purposes only
-		if((btnY.action) && (btnY.delay3)){
-			btnY.action = FALSE;
+		if(ev == (BTN_EV_LONG | BTN_Y)){
 			count = 0;
 			selection ^= 1;
 			if(display_mode == DISP_MODE_1)
 				display_mode = DISP_MODE_2;
 			else
 				display_mode = DISP_MODE_1;
+			buttons_repeat_time(selection && (display_mode != DISP_MODE_2));
 		}
-		// If Z is pressed, increment the selected quantity
-		if(btnZ.action){
+		// If Z is pressed, increment the selected quantity. If pressed and hold,
+		// auto-repeat increments it faster and faster (see buttons_repeat_time())
+		if((ev == (BTN_EV_PRESS | BTN_Z)) || (ev == (BTN_EV_REPEAT | BTN_Z))){
 			if(display_mode == DISP_MODE_1){
-				if(btnZ.state == BTN_RELEASED){
-					if(selection) increment_time(INC_HOUR);
-					else increment_time(INC_MIN);
-					update_time_variables();
-					btnZ.action = FALSE;
-				} else if((btnZ.delay1) && (btnZ.delay2)){
-					btnZ.delay2 = FALSE;
-					if(selection) increment_time(INC_HOUR);
-					else increment_time(INC_MIN);
-					update_time_variables();
-				}
+				if(selection) increment_time(INC_HOUR);
+				else increment_time(INC_MIN);
 			} else if(display_mode == DISP_MODE_2){
-				if(btnZ.state == BTN_RELEASED){
-					if(selection) increment_time(INC_MIN);
-					else increment_time(INC_SEC);
-					update_time_variables();
-					btnZ.action = FALSE;
-				} else if((btnZ.delay1) && (btnZ.delay2)){
-					btnZ.delay2 = FALSE;
-					if(selection) increment_time(INC_MIN);
-					else increment_time(INC_SEC);
-					update_time_variables();
-				}
+				if(selection) increment_time(INC_MIN);
+				else increment_time(INC_SEC);
 			}
+			update_time_variables();
+			count = 0;
+		}
+		// Repeats at the end of the curve jump to the next tens
+		if(ev == (BTN_EV_REPEAT | BTN_EV_FAST | BTN_Z)){
+			if(display_mode == DISP_MODE_1) increment_time_tens(INC_MIN);
+			else if(selection) increment_time_tens(INC_MIN);
+			else increment_time_tens(INC_SEC);
+			update_time_variables();
 			count = 0;
 		}
 
@@ -977,6 +967,11 @@ void set_time(volatile state_t *state)
 			break;
 
 	}	/* INFINITE LOOP */
+
+	// the user has set (or at least checked) the time. A time sync slew in
+	// progress no longer applies
+	time.stale = FALSE;
+	timer_rtc_slew(0);
 }
 
 /*===========================================================================*/
@@ -987,12 +982,14 @@ void set_time(volatile state_t *state)
 */
 void set_hour_mode(volatile state_t *state)
 {
+	uint8_t ev;
 	uint16_t count = 0;
 	uint8_t toggle = 0;
 
 	display.d1 = BLANK;
 	display.d2 = BLANK;
 	timer_leds_set(ENABLE, 10, 10, 100);
+	buttons_flush();
 
 	/*
 	* INFINITE LOOP
@@ -1018,35 +1015,28 @@ void set_hour_mode(volatile state_t *state)
 		}
 
 		/* 
-		* BUTTONS check: Buttons are detected using an ISR which sets btnXYZ
-	    * flags. Once set, the rest of the detection and debounce routine is
-	    * handled within buttons_check(), based on the 1ms execution period of
-	    * the main infinite loop
-	    *
-	    * BUTTONS actions:
-		* - executed according to the buttons state flags
+		* BUTTONS events: Buttons are sampled and debounced by the 1ms timer
+		* ISR, which queues the button events (see buttons.c). One event is
+		* consumed per loop execution.
+		*
+		* BUTTONS actions:
+		* - executed according to the received event
 		*/
-		if(btnX.query) buttons_check(&btnX);
-	    if(btnY.query) buttons_check(&btnY);
-	    if(btnZ.query) buttons_check(&btnZ);
+		ev = buttons_get();
 		// If either Y or Z are pressed, change the hour mode
-		if((btnY.action) || (btnZ.action)){
-			btnY.action = FALSE;
-			btnZ.action = FALSE;
+		if((ev == (BTN_EV_PRESS | BTN_Y)) || (ev == (BTN_EV_PRESS | BTN_Z))){
 			if(time.hour_mode == MODE_12H) change_hour_mode(MODE_24H);
 			else if(time.hour_mode == MODE_24H) change_hour_mode(MODE_12H);
 			update_time_variables();
 			count = 0;
 		}
 		// If X pressed shortly, return to the menu
-		if((btnX.action) && (btnX.state == BTN_RELEASED) && (!btnX.delay1)){
-			btnX.action = FALSE;
+		if(ev == BTN_CLICK(BTN_X)){
 			*state = DISPLAY_MENU;
 		}
-		// If X pressed and hold for delay3 ms, return to display the time
-		if((btnX.action) && (btnX.delay3)){
+		// If X pressed and hold for 2 seconds, return to display the time
+		if(ev == (BTN_EV_LONG | BTN_X)){
 			*state = DISPLAY_TIME;
-			btnX.action = FALSE;
 		}
 
 		/*
@@ -1128,6 +1118,17 @@ static void increment_time(uint8_t what)
 	else if(time.day_period == PERIOD_PM) timer_leds_set(ENABLE, 20, 20, 65);
 }
 
+/*===========================================================================*/
+/*
+* Increments minutes or seconds up to the next multiple of 10
+*/
+static void increment_time_tens(uint8_t what)
+{
+	do {
+		increment_time(what);
+	} while(((what == INC_MIN) ? time.min : time.sec) % 10);
+}
+
 /*===========================================================================*/
 /*
 * Changes Hour Mode
@@ -1157,38 +1158,3 @@ static void change_hour_mode(uint8_t mode)
 		else if((alarm.day_period == PERIOD_PM) && (alarm.hour != 12)) alarm.hour += 12;
 	}
 }
-
-/*===========================================================================*/
-/*
-* Used for breathing effect. Returns a PWM value from a vector stored in FLASH
-* That vector is computed as a quadratic function. The quadratic function was 
-* chosen so that v = 0 gives a value of PWM = 1, and v = 1999 gives a value of 
-* PWM = 250 (provided a scale factor of 1). Different scale factors are 
-* provided for different color intensities.
-* This function was previously implemented using floating-point operations, but
-* it was very time-consuming, so this strategy (query a stored value) is much
-* faster.
-*/
-static uint8_t led_pwm_value(uint8_t led, uint16_t v)
-{
-	uint8_t x = (uint8_t)(v / 8);
-	uint8_t pwm = pgm_read_byte(&led_pwm[x]);
-	float scale;
-	uint8_t out;
-
-	if (led == LED_RED) {
-		if (time.day_period == PERIOD_AM) scale = 0.2;
-		else scale = 0.08;
-	} else if (led == LED_GREEN) {
-		if (time.day_period == PERIOD_AM) scale = 0.12;
-		else scale = 0.08;
-	} else if (led == LED_BLUE) {
-		if (time.day_period == PERIOD_AM) scale = 0.0;
-		else scale = 0.26;
-	}
-
-	out = (uint8_t)(scale * (float)pwm);
-	out += 1;
-	
-	return out;
-}
\ No newline at end of file
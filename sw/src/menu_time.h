@@ -37,6 +37,7 @@ typedef volatile struct {
 	uint8_t update;			// flag. 1Hz update?
 	uint8_t hour_mode;		// 12/24h 
 	uint8_t day_period;		// AM/PM
+	uint8_t stale;			// flag. Restored from the journal, not set by user?
 } time_s;
 
 extern time_s time;
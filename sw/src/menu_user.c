@@ -14,8 +14,11 @@
 ******************************************************************************/
 
 #include "menu_user.h"
+#include "buttons.h"
 #include "buzzer.h"
 #include "config.h"
+#include "init.h"
+#include "log.h"
 #include "timers.h"
 #include "uart.h"
 #include "util.h"
@@ -30,6 +33,9 @@
 ******************* C O N S T A N T   D E F I N I T I O N S *******************
 ******************************************************************************/
 
+// Tag of the log messages (see log.h)
+#define LOG_TAG		"user"
+
 // 3D Sequence of digits stored as a vector. Used for an animation
 static const uint8_t animation_3d_t1[] PROGMEM = {
 	3,8,9,4,0,5,7,2,6,1,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF,0xFF
@@ -52,19 +58,22 @@ static uint8_t change_transition_mode(uint8_t dir);
 */
 void intro(volatile state_t *state)
 {
+    uint8_t ev;
     uint8_t count = 0;
     uint8_t n = 0;
     uint8_t c = 0;
     uint8_t d = 0;
 
-	uart_send_string_p(PSTR("\n\r\n\rHello World!\n\r"));
+	LOG_I("Hello World!");
     display.set = ON;
+	boot_log(BOOT_DISPLAY);
 	display.fade_level[0] = 5;
 	display.fade_level[1] = 5;
 	display.fade_level[2] = 5;
 	display.fade_level[3] = 5;
 	timer_leds_set(ENABLE, 250, 250, 250);
-    
+	buttons_flush();
+
 	/*
 	* INFINITE LOOP
 	*/
@@ -98,26 +107,28 @@ void intro(volatile state_t *state)
 		}
 		
 		/* 
-		* BUTTONS check: Buttons are detected using an ISR which sets btnXYZ
-	    * flags. Once set, the rest of the detection and debounce routine is
-	    * handled within buttons_check(), based on the 1ms execution period of
-	    * the main infinite loop
-	    *
-	    * BUTTONS actions:
-		* - executed according to the buttons state flags
+		* BUTTONS events: Buttons are sampled and debounced by the 1ms timer
+		* ISR, which queues the button events (see buttons.c). One event is
+		* consumed per loop execution.
+		*
+		* BUTTONS actions:
+		* - executed according to the received event
 		*/
-		if(btnX.query) buttons_check(&btnX);
-	    if(btnY.query) buttons_check(&btnY);
-	    if(btnZ.query) buttons_check(&btnZ);
+		ev = buttons_get();
+		// Y or Z click skips the intro
+		if((ev == BTN_CLICK(BTN_Y)) || (ev == BTN_CLICK(BTN_Z))){
+			buzzer_music(MAJOR_SCALE, DISABLE);
+			c = 4;
+			d = 2;
+		}
 		// If both things are finished (3D sequence and buzzer sound), exit.
 		if((c >= 4) && (d >= 2)){
 			display.d1 = BLANK;
 			display.d2 = BLANK;
 			display.d3 = BLANK;
 			display.d4 = BLANK;
-			// If X is pressed, jump to TEST_TUBES
-			if(btnX.action){
-				btnX.action = FALSE;
+			// If X is still held, jump to TEST_TUBES
+			if(buttons_state() & BTN_X){
 				*state = USR_TEST;
 			} else {
 				*state = DISPLAY_TIME;
@@ -152,6 +163,7 @@ void intro(volatile state_t *state)
 */
 void display_menu(volatile state_t *state)
 {
+	uint8_t ev;
 	uint8_t menu_mode = 1;
 	uint16_t count = 0;
 
@@ -164,6 +176,7 @@ void display_menu(volatile state_t *state)
 	display.fade_level[2] = 5;
 	display.fade_level[3] = 5;
 	timer_leds_set(ENABLE, 250, 0, 250);
+	buttons_flush();
 
 	/*
 	* INFINITE LOOP
@@ -178,35 +191,30 @@ void display_menu(volatile state_t *state)
 		display.d2 = menu_mode;
 
 		/* 
-		* BUTTONS check: Buttons are detected using an ISR which sets btnXYZ
-	    * flags. Once set, the rest of the detection and debounce routine is
-	    * handled within buttons_check(), based on the 1ms execution period of
-	    * the main infinite loop
-	    *
-	    * BUTTONS actions:
-		* - executed according to the buttons state flags
+		* BUTTONS events: Buttons are sampled and debounced by the 1ms timer
+		* ISR, which queues the button events (see buttons.c). One event is
+		* consumed per loop execution.
+		*
+		* BUTTONS actions:
+		* - executed according to the received event
 		*/
-		if(btnX.query) buttons_check(&btnX);
-	    if(btnY.query) buttons_check(&btnY);
-	    if(btnZ.query) buttons_check(&btnZ);
+		ev = buttons_get();
 		// If Y is pressed, decrement menu mode to the previous option
-		if(btnY.action){
-			btnY.action = FALSE;
+		if(ev == (BTN_EV_PRESS | BTN_Y)){
 			menu_mode--;
 			if(menu_mode == 0) menu_mode = 6;
 			count = 0;
 		}
 		// If Z is pressed, increment menu mode to the next option
-		if(btnZ.action){
-			btnZ.action = FALSE;
+		if(ev == (BTN_EV_PRESS | BTN_Z)){
 			menu_mode++;
 			if(menu_mode == 7) menu_mode = 1;
 			count = 0;
 		}
 		// If X is pressed, enter the selected menu mode. If pressed and hold,
 		// go back to DISPLAY_TIME
-		if(btnX.action){ 
-			if(btnX.state == BTN_RELEASED){
+		if(BTN_EV_BTNS(ev) == BTN_X){
+			if(BTN_EV_TYPE(ev) == BTN_EV_RELEASE){
 				switch(menu_mode){
 					case 1: *state = SET_TIME; break;
 					case 2: *state = SET_ALARM; break;
@@ -216,10 +224,8 @@ void display_menu(volatile state_t *state)
 					case 6: *state = SET_ALARM_THEME; break;
 					default: *state = DISPLAY_TIME; break;
 				}
-				btnX.action = FALSE;
-			} else if(btnX.delay3){
+			} else if(BTN_EV_TYPE(ev) == BTN_EV_LONG){
 				*state = DISPLAY_TIME;
-				btnX.action = FALSE;
 			}
 			count = 0;
 		}
@@ -260,6 +266,7 @@ void display_menu(volatile state_t *state)
 */
 void set_transitions(volatile state_t *state)
 {
+	uint8_t ev;
 	uint16_t count = 0;
 	uint8_t toggle = 0;
 
@@ -272,7 +279,8 @@ void set_transitions(volatile state_t *state)
 	display.d2 = BLANK;
 	display.d3 = BLANK;
 	timer_leds_set(ENABLE, 100, 10, 10);
-	
+	buttons_flush();
+
 	/*
 	* INFINITE LOOP
 	*/
@@ -293,38 +301,31 @@ void set_transitions(volatile state_t *state)
 		}
 		
 		/* 
-		* BUTTONS check: Buttons are detected using an ISR which sets btnXYZ
-	    * flags. Once set, the rest of the detection and debounce routine is
-	    * handled within buttons_check(), based on the 1ms execution period of
-	    * the main infinite loop
-	    *
-	    * BUTTONS actions:
-		* - executed according to the buttons state flags
+		* BUTTONS events: Buttons are sampled and debounced by the 1ms timer
+		* ISR, which queues the button events (see buttons.c). One event is
+		* consumed per loop execution.
+		*
+		* BUTTONS actions:
+		* - executed according to the received event
 		*/
-		if(btnX.query) buttons_check(&btnX);
-	    if(btnY.query) buttons_check(&btnY);
-	    if(btnZ.query) buttons_check(&btnZ);
+		ev = buttons_get();
 		// If Y pressed, switch to the previous transition animation
-		if(btnY.action){
-			btnY.action = FALSE;
+		if(ev == (BTN_EV_PRESS | BTN_Y)){
 			count = 0;
 			display.mode = change_transition_mode(DOWN);
 		}
 		// If Z pressed, switch to the next transition animation
-		if(btnZ.action){
-			btnZ.action = FALSE;
+		if(ev == (BTN_EV_PRESS | BTN_Z)){
 			count = 0;
 			display.mode = change_transition_mode(UP);
 		}
 		// If X pressed, return to the menu
-		if((btnX.action) && (btnX.state == BTN_RELEASED) && (!btnX.delay1)){
-			btnX.action = FALSE;
+		if(ev == BTN_CLICK(BTN_X)){
 			*state = DISPLAY_MENU;
 		}
 		// If X pressed and hold, return to display the time
-		if((btnX.action) && (btnX.delay3)){
+		if(ev == (BTN_EV_LONG | BTN_X)){
 			*state = DISPLAY_TIME;
-			btnX.action = FALSE;
 		}
 
 		/*
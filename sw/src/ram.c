@@ -0,0 +1,97 @@
+/**
+ * @file ram.c
+ * @brief RAM usage: stack high-water mark and static allocation
+ *
+ * The 2KB of SRAM hold, from the bottom up, the .data, .bss and .noinit
+ * sections (fixed at link time, see the map file) and the stack, which
+ * grows down from RAMEND. There's no heap: malloc() isn't used (the buzzer
+ * melodies take their note durations from a static pool, see buzzer.c), so
+ * everything between __heap_start and the stack is headroom.
+ *
+ * That free space is painted with RAM_PAINT before main(). The deepest the
+ * stack has ever grown since the reset is found by looking for the first
+ * byte above __heap_start that isn't painted anymore. A stack byte that
+ * happens to hold RAM_PAINT may hide a few bytes of the peak, so keep a
+ * margin (see tools/ram_check.c).
+ *
+ * @date 19.10.2026
+ *
+ */
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include "ram.h"
+#include "buzzer.h"
+#include "uart.h"
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+/******************************************************************************
+*************** G L O B A L   V A R S   D E F I N I T I O N S *****************
+******************************************************************************/
+
+// End of the static sections (linker script)
+extern uint8_t __heap_start;
+
+/******************************************************************************
+******************* F U N C T I O N   D E F I N I T I O N S *******************
+******************************************************************************/
+
+static void ram_paint(void) __attribute__((naked, used, section(".init3")));
+
+/*===========================================================================*/
+/*
+* RAM taken by the .data, .bss and .noinit sections
+*/
+uint16_t ram_static(void)
+{
+	return &__heap_start - (const uint8_t *)RAMSTART;
+}
+
+/*===========================================================================*/
+/*
+* Most stack used since the reset, ISRs included
+*/
+uint16_t ram_stack_peak(void)
+{
+	const uint8_t *p = &__heap_start;
+
+	while((p <= (const uint8_t *)RAMEND) && (*p == RAM_PAINT)) p++;
+	return ((const uint8_t *)RAMEND + 1) - p;
+}
+
+/*===========================================================================*/
+/*
+* Prints the RAM usage (shell "ram"). The three numbers add up to the SRAM
+* size
+*/
+void ram_report(void)
+{
+	uint16_t stack = ram_stack_peak();
+	uint16_t used = ram_static();
+
+	uart_printf_P(PSTR("RAM (bytes): static %u, stack peak %u, never used %u\n\r"),
+		used, stack, (RAMEND + 1 - RAMSTART) - used - stack);
+	uart_printf_P(PSTR("Notes pool (bytes): peak %u of %u\n\r"),
+		buzzer_pool_peak(), buzzer_pool_size());
+}
+
+/*-----------------------------------------------------------------------------
+-------------------------- L O C A L   F U N C T I O N S ----------------------
+-----------------------------------------------------------------------------*/
+
+/*===========================================================================*/
+/*
+* Runs before main(), right after the stack pointer is set to RAMEND, when
+* nothing is on the stack yet. Plain code only: no stack frame
+*/
+static void ram_paint(void)
+{
+	uint8_t *p = &__heap_start;
+
+	while(p <= (uint8_t *)RAMEND) *p++ = RAM_PAINT;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file ram.h
+ * @brief RAM usage: stack high-water mark and static allocation
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#ifndef RAM_H
+#define RAM_H
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include <stdint.h>
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Fill byte of the RAM that is not statically allocated, at startup
+#define RAM_PAINT		0xC5
+
+/******************************************************************************
+******************** F U N C T I O N   P R O T O T Y P E S ********************
+******************************************************************************/
+
+uint16_t ram_static(void);
+uint16_t ram_stack_peak(void);
+void ram_report(void);
+
+#endif /* RAM_H */
@@ -0,0 +1,161 @@
+/**
+ * @file remote.c
+ * @brief Remote display: tubes and LEDs frames streamed through the UART
+ *
+ * REMOTE_DISPLAY state, entered with the shell "stream" command. The host
+ * sends frames with the four digits, their fade levels and the LEDs color
+ * (see tools/stream.c); every valid frame is acknowledged with its sequence
+ * number. Without valid frames for REMOTE_TIMEOUT, or with a long press of
+ * X, the clock goes back to DISPLAY_TIME.
+ *
+ * Chars are queued by the UART RX ISR. A frame is decoded into its own
+ * buffer and copied into the display structure and the LEDs timers in one
+ * go, while interrupts are disabled: the multiplexing ISR never shows half
+ * a frame.
+ *
+ * @date 19.10.2026
+ *
+ */
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include "remote.h"
+#include "buttons.h"
+#include "config.h"
+#include "leds.h"
+#include "timers.h"
+#include "uart.h"
+
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <util/crc16.h>
+
+/******************************************************************************
+******************* F U N C T I O N   D E F I N I T I O N S *******************
+******************************************************************************/
+
+static uint8_t decode(const uint8_t *buf, uint8_t n, uint8_t *f);
+static void show(const uint8_t *f);
+static uint8_t digit(uint8_t nibble);
+
+/*===========================================================================*/
+/*
+* REMOTE DISPLAY STATE
+*/
+void remote_display(volatile state_t *state)
+{
+	uint8_t buf[REMOTE_BUF_SIZE];
+	uint8_t f[REMOTE_FRAME_SIZE + 2];
+	uint8_t n = 0;
+	uint8_t discard = FALSE;
+	uint16_t timeout = REMOTE_TIMEOUT;
+	uint16_t frames = 0, bad = 0;
+	char c;
+
+	display.set = ON;
+	leds_animate(LEDS_MANUAL);
+	buttons_flush();
+
+	/*
+	* INFINITE LOOP
+	*/
+	while(TRUE){
+
+		/*
+		* FRAMES: every complete frame is shown right away. If several of
+		* them arrived within the same ms, only the last one is
+		*/
+		while(uart_rx_get(&c)){
+			if((uint8_t)c == REMOTE_DELIMITER){
+				if(n && !discard){
+					if(decode(buf, n, f)){
+						show(f);
+						uart_send_char((char)f[0]);
+						timeout = REMOTE_TIMEOUT;
+						frames++;
+					} else {
+						bad++;
+					}
+				}
+				n = 0;
+				discard = FALSE;
+			} else if(n < REMOTE_BUF_SIZE){
+				buf[n++] = (uint8_t)c;
+			} else if(!discard){
+				// too long: not a frame
+				discard = TRUE;
+				bad++;
+			}
+		}
+
+		// No frames for a while: the stream has stopped
+		timeout--;
+		if(!timeout) *state = DISPLAY_TIME;
+
+		// If X pushed for 2 seconds, go back to DISPLAY_TIME
+		if(buttons_get() == (BTN_EV_LONG | BTN_X)) *state = DISPLAY_TIME;
+
+		/* 
+		* LOOP DELAY AND INTERRUPT ENABLE TIME --------------------------------
+		*/
+		sei();
+		// Wait for the next ms.
+		while(!loop);
+		loop = FALSE;
+		cli();
+		// If system state changed, exit fuction.
+		if(*state != REMOTE_DISPLAY)
+			break;
+
+	}	/* INFINITE LOOP */
+
+	uart_printf_P(PSTR("\n\rSTREAM END. Frames: %u, bad: %u\n\r"), frames, bad);
+}
+
+/*-----------------------------------------------------------------------------
+-------------------------- L O C A L   F U N C T I O N S ----------------------
+-----------------------------------------------------------------------------*/
+
+/*===========================================================================*/
+/*
+* COBS decoding of a received frame into f (frame and CRC, plus one byte
+* to detect longer frames). Returns TRUE if it's a valid frame
+*/
+static uint8_t decode(const uint8_t *buf, uint8_t n, uint8_t *f)
+{
+	uint8_t i = 0, o = 0, code, crc = 0;
+
+	while(i < n){
+		code = buf[i++];
+		if(((i + code - 1) > n) || ((o + code) > (REMOTE_FRAME_SIZE + 2))) return FALSE;
+		while(--code) f[o++] = buf[i++];
+		if(i < n) f[o++] = 0;
+	}
+	if(o != (REMOTE_FRAME_SIZE + 1)) return FALSE;
+	for(i = 0; i < REMOTE_FRAME_SIZE; i++)
+		crc = _crc8_ccitt_update(crc, f[i]);
+	return (crc == f[REMOTE_FRAME_SIZE]);
+}
+
+/*===========================================================================*/
+static void show(const uint8_t *f)
+{
+	display.d1 = digit(f[1] >> 4);
+	display.d2 = digit(f[1] & 0x0F);
+	display.d3 = digit(f[2] >> 4);
+	display.d4 = digit(f[2] & 0x0F);
+	for(uint8_t i = 0; i < 4; i++){
+		uint8_t level = (i & 1) ? (f[3 + (i >> 1)] & 0x0F) : (f[3 + (i >> 1)] >> 4);
+		display.fade_level[i] = (level > 5) ? 5 : level;
+	}
+	timer_leds_set(ENABLE, f[5], f[6], f[7]);
+}
+
+/*===========================================================================*/
+static uint8_t digit(uint8_t nibble)
+{
+	return (nibble > 9) ? BLANK : nibble;
+}
@@ -0,0 +1,43 @@
+/**
+ * @file remote.h
+ * @brief Remote display: tubes and LEDs frames streamed through the UART
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#ifndef REMOTE_H
+#define REMOTE_H
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include "config.h"
+
+#include <stdint.h>
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+/*
+* Frame: sequence number, digits (d1 d2 and d3 d4, one nibble each; over 9
+* is blank), fade levels (tubes A B and C D, one nibble each, 0 to 5) and
+* the red, green and blue LEDs levels, followed by a CRC-8 CCITT. Frames are
+* COBS encoded and delimited by 0x00, the same as the telemetry frames
+*/
+#define REMOTE_FRAME_SIZE	8
+#define REMOTE_BUF_SIZE		(REMOTE_FRAME_SIZE + 2)	// encoded, CRC included
+#define REMOTE_DELIMITER	0x00
+
+// Time without valid frames before going back to DISPLAY_TIME (ms)
+#define REMOTE_TIMEOUT		2000
+
+/******************************************************************************
+******************** F U N C T I O N   P R O T O T Y P E S ********************
+******************************************************************************/
+
+void remote_display(volatile state_t *state);
+
+#endif	/* REMOTE_H */
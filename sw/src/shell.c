@@ -0,0 +1,465 @@
+/**
+ * @file shell.c
+ * @brief Serial command shell
+ *
+ * Line oriented commands received through the UART while the time is
+ * displayed. Chars are queued by the UART RX ISR, and shell_poll() takes
+ * them from the receive ring once per loop of display_time(), so a command
+ * never blocks the display. Lines end with CR or LF; words are separated by
+ * spaces. Every reply ends with "OK" or "ERR".
+ *
+ *   help                       list of commands
+ *   time                       current time (24h)
+ *   time set HH:MM[:SS]        set the time (24h)
+ *   alarm                      alarm time and state
+ *   alarm set HH:MM            set the alarm time (24h)
+ *   alarm on | off             enable or disable the alarm
+ *   mode [1-4]                 show or select the transition effect
+ *   stats                      boot log, loop load, supply faults, resets
+ *   ram                        static RAM, stack peak, free RAM
+ *   settings dump              user settings
+ *   telemetry [text | binary]  show or select the serial output mode
+ *   sync T1                    time sync request (see tools/timesync.c)
+ *   sync adjust MS             step or slew the time by MS milliseconds
+ *   stream                     tubes and LEDs frames follow (see remote.c)
+ *   bench                      formatting cost of uart_printf_P()
+ *   loopback                   echo raw bytes (see tools/loopback.c)
+ *   update                     firmware update (see tools/upload.c)
+ *
+ * @date 19.10.2026
+ *
+ */
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include "shell.h"
+#include "adc.h"
+#include "clock.h"
+#include "config.h"
+#include "eeprom.h"
+#include "init.h"
+#include "menu_alarm.h"
+#include "menu_time.h"
+#include "ram.h"
+#include "sleep.h"
+#include "telemetry.h"
+#include "timers.h"
+#include "uart.h"
+#include "util.h"
+#include "watchdog.h"
+
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/******************************************************************************
+*************** G L O B A L   V A R S   D E F I N I T I O N S *****************
+******************************************************************************/
+
+static char line[SHELL_LINE_SIZE];
+static uint8_t line_len = 0;
+static uint8_t overflow = FALSE;
+// State of the system, for the commands that change it
+static volatile state_t *shell_state;
+// Loopback echo running, and time of the last byte received (ms)
+static volatile uint8_t loopback = FALSE;
+static uint16_t loopback_ms;
+static uint8_t update = FALSE;
+
+/******************************************************************************
+******************* F U N C T I O N   D E F I N I T I O N S *******************
+******************************************************************************/
+
+static uint8_t execute(char *s);
+static uint8_t split(char *s, char **argv);
+static uint8_t parse_hhmm(const char *s, uint8_t *h, uint8_t *m, uint8_t *sec);
+static void send_2d(uint8_t n);
+static void send_hhmm(uint8_t hour, uint8_t period, uint8_t min);
+static void cmd_help(void);
+static uint8_t cmd_time(uint8_t argc, char **argv);
+static uint8_t cmd_alarm(uint8_t argc, char **argv);
+static uint8_t cmd_mode(uint8_t argc, char **argv);
+static void cmd_stats(void);
+static void cmd_settings(void);
+static uint8_t cmd_telemetry(uint8_t argc, char **argv);
+static uint8_t cmd_sync(uint8_t argc, char **argv);
+static void run_bootloader(void);
+
+/*===========================================================================*/
+void shell_init(void)
+{
+	line_len = 0;
+	overflow = FALSE;
+}
+
+/*===========================================================================*/
+/*
+* TRUE while the loopback echo runs: no other output may go through the
+* serial port
+*/
+uint8_t shell_loopback(void)
+{
+	return loopback;
+}
+
+/*===========================================================================*/
+/*
+* Takes the received chars from the UART ring. A complete line is executed.
+* Lines longer than SHELL_LINE_SIZE are discarded as a whole. Once a command
+* changes the system state, the following chars are left for the new one.
+*/
+void shell_poll(volatile state_t *state)
+{
+	char c;
+
+	shell_state = state;
+	if(loopback){
+		// every byte goes back as is, until the line is quiet
+		while(uart_rx_get(&c)){
+			uart_send_char(c);
+			loopback_ms = timer_base_now();
+		}
+		if((uint16_t)(timer_base_now() - loopback_ms) >= SHELL_LOOPBACK_TIMEOUT){
+			loopback = FALSE;
+			uart_send_string_p(PSTR("\n\rLOOPBACK END\n\r"));
+		}
+		return;
+	}
+	while((*state == DISPLAY_TIME) && uart_rx_get(&c)){
+		if((c == '\r') || (c == '\n')){
+			if(line_len && !overflow){
+				line[line_len] = '\0';
+				uart_send_string_p(PSTR("\n\r"));
+				if(execute(line)) uart_send_string_p(PSTR("OK\n\r"));
+				else uart_send_string_p(PSTR("ERR\n\r"));
+				if(update) run_bootloader();
+			} else if(overflow){
+				uart_send_string_p(PSTR("\n\rERR\n\r"));
+			}
+			line_len = 0;
+			overflow = FALSE;
+		} else if((c == '\b') || (c == 0x7F)){
+			if(line_len){
+				line_len--;
+				uart_send_string_p(PSTR("\b \b"));
+			}
+		} else if(line_len < (SHELL_LINE_SIZE - 1)){
+			line[line_len++] = c;
+			uart_send_char(c);
+		} else {
+			overflow = TRUE;
+		}
+	}
+}
+
+/*-----------------------------------------------------------------------------
+-------------------------- L O C A L   F U N C T I O N S ----------------------
+-----------------------------------------------------------------------------*/
+
+/*===========================================================================*/
+/*
+* Runs a command line. Returns FALSE if the command or its arguments are
+* not valid
+*/
+static uint8_t execute(char *s)
+{
+	char *argv[SHELL_ARGS_MAX];
+	uint8_t argc = split(s, argv);
+
+	if(!argc) return FALSE;
+	if(!strcmp_P(argv[0], PSTR("help"))){
+		cmd_help();
+		return TRUE;
+	}
+	if(!strcmp_P(argv[0], PSTR("time"))) return cmd_time(argc, argv);
+	if(!strcmp_P(argv[0], PSTR("alarm"))) return cmd_alarm(argc, argv);
+	if(!strcmp_P(argv[0], PSTR("mode"))) return cmd_mode(argc, argv);
+	if(!strcmp_P(argv[0], PSTR("telemetry"))) return cmd_telemetry(argc, argv);
+	if(!strcmp_P(argv[0], PSTR("sync"))) return cmd_sync(argc, argv);
+	if(!strcmp_P(argv[0], PSTR("stream")) && (argc == 1)){
+		*shell_state = REMOTE_DISPLAY;
+		return TRUE;
+	}
+	if(!strcmp_P(argv[0], PSTR("loopback")) && (argc == 1)){
+		loopback = TRUE;
+		loopback_ms = timer_base_now();
+		return TRUE;
+	}
+	if(!strcmp_P(argv[0], PSTR("update")) && (argc == 1)){
+		update = TRUE;
+		return TRUE;
+	}
+	if(!strcmp_P(argv[0], PSTR("bench")) && (argc == 1)){
+		uart_printf_bench();
+		return TRUE;
+	}
+	if(!strcmp_P(argv[0], PSTR("stats")) && (argc == 1)){
+		cmd_stats();
+		return TRUE;
+	}
+	if(!strcmp_P(argv[0], PSTR("ram")) && (argc == 1)){
+		ram_report();
+		return TRUE;
+	}
+	if(!strcmp_P(argv[0], PSTR("settings")) && (argc == 2) &&
+		!strcmp_P(argv[1], PSTR("dump"))){
+		cmd_settings();
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/*===========================================================================*/
+/*
+* Splits the line into words, in place. Returns the number of words, or 0
+* if there're more than SHELL_ARGS_MAX
+*/
+static uint8_t split(char *s, char **argv)
+{
+	uint8_t argc = 0;
+
+	while(*s){
+		while(*s == ' ') *s++ = '\0';
+		if(!*s) break;
+		if(argc == SHELL_ARGS_MAX) return 0;
+		argv[argc++] = s;
+		while(*s && (*s != ' ')) s++;
+	}
+	return argc;
+}
+
+/*===========================================================================*/
+/*
+* Parses "HH:MM" or, if sec is not NULL, "HH:MM[:SS]". 24h format
+*/
+static uint8_t parse_hhmm(const char *s, uint8_t *h, uint8_t *m, uint8_t *sec)
+{
+	uint8_t v[3] = {0, 0, 0};
+	uint8_t n = 0, digits = 0;
+
+	for(; ; s++){
+		if((*s >= '0') && (*s <= '9')){
+			if(++digits > 2) return FALSE;
+			v[n] = (v[n] * 10) + (*s - '0');
+		} else if((*s == ':') || (*s == '\0')){
+			if(!digits) return FALSE;
+			digits = 0;
+			n++;
+			if(*s == '\0') break;
+			if(n == 3) return FALSE;
+		} else {
+			return FALSE;
+		}
+	}
+	if((n < 2) || ((n == 3) && (sec == NULL))) return FALSE;
+	if((v[0] > 23) || (v[1] > 59) || (v[2] > 59)) return FALSE;
+	*h = v[0];
+	*m = v[1];
+	if(sec != NULL) *sec = v[2];
+	return TRUE;
+}
+
+/*===========================================================================*/
+static void send_2d(uint8_t n)
+{
+	uart_send_char('0' + (n / 10));
+	uart_send_char('0' + (n % 10));
+}
+
+/*===========================================================================*/
+/*
+* Sends a time as HH:MM, 24h format
+*/
+static void send_hhmm(uint8_t hour, uint8_t period, uint8_t min)
+{
+	send_2d(hour_to_24(hour, period));
+	uart_send_char(':');
+	send_2d(min);
+}
+
+/*===========================================================================*/
+static void cmd_help(void)
+{
+	uart_send_string_p(PSTR("time [set HH:MM[:SS]]\n\r"));
+	uart_send_string_p(PSTR("alarm [set HH:MM | on | off]\n\r"));
+	uart_send_string_p(PSTR("mode [1-4]\n\r"));
+	uart_send_string_p(PSTR("stats\n\r"));
+	uart_send_string_p(PSTR("ram\n\r"));
+	uart_send_string_p(PSTR("settings dump\n\r"));
+	uart_send_string_p(PSTR("telemetry [text | binary]\n\r"));
+	uart_send_string_p(PSTR("sync T1 | sync adjust MS\n\r"));
+	uart_send_string_p(PSTR("stream\n\r"));
+	uart_send_string_p(PSTR("bench\n\r"));
+	uart_send_string_p(PSTR("loopback\n\r"));
+	uart_send_string_p(PSTR("update\n\r"));
+}
+
+/*===========================================================================*/
+/*
+* The new time takes effect right away: the RTC ISR can't run while the
+* system states are executing. It's no longer stale, and it's saved in the
+* time journal
+*/
+static uint8_t cmd_time(uint8_t argc, char **argv)
+{
+	uint8_t h, m, s;
+
+	if(argc == 3){
+		if(strcmp_P(argv[1], PSTR("set"))) return FALSE;
+		if(!parse_hhmm(argv[2], &h, &m, &s)) return FALSE;
+		// the new second starts right now
+		time_of_day_set((((uint32_t)h * 3600) + ((uint16_t)m * 60) + s) * 1000);
+		rom_journal_checkpoint();
+		telemetry_event(TLM_EV_TIME_SET, hour_to_24(time.hour, time.day_period), time.min);
+	} else if(argc != 1) {
+		return FALSE;
+	}
+	send_hhmm(time.hour, time.day_period, time.min);
+	uart_send_char(':');
+	send_2d(time.sec);
+	uart_send_string_p(PSTR("\n\r"));
+	return TRUE;
+}
+
+/*===========================================================================*/
+static uint8_t cmd_alarm(uint8_t argc, char **argv)
+{
+	uint8_t h, m;
+
+	if((argc == 3) && !strcmp_P(argv[1], PSTR("set"))){
+		if(!parse_hhmm(argv[2], &h, &m, NULL)) return FALSE;
+		hour_from_24(h, &alarm.hour, &alarm.day_period);
+		alarm.min = m;
+		alarm.sec = 0;
+		update_time_variables();
+		rom_settings_save();
+	} else if((argc == 2) && !strcmp_P(argv[1], PSTR("on"))){
+		alarm.active = TRUE;
+		rom_settings_save();
+	} else if((argc == 2) && !strcmp_P(argv[1], PSTR("off"))){
+		alarm.active = FALSE;
+		rom_settings_save();
+	} else if(argc != 1){
+		return FALSE;
+	}
+	send_hhmm(alarm.hour, alarm.day_period, alarm.min);
+	if(alarm.active) uart_send_string_p(PSTR(" on\n\r"));
+	else uart_send_string_p(PSTR(" off\n\r"));
+	return TRUE;
+}
+
+/*===========================================================================*/
+static uint8_t cmd_mode(uint8_t argc, char **argv)
+{
+	if(argc == 2){
+		if((argv[1][0] < '1') || (argv[1][0] > '4') || argv[1][1]) return FALSE;
+		display.mode = DISP_MODE_1 + (argv[1][0] - '1');
+		rom_settings_save();
+	} else if(argc != 1){
+		return FALSE;
+	}
+	uart_send_char('1' + (display.mode - DISP_MODE_1));
+	uart_send_string_p(PSTR("\n\r"));
+	return TRUE;
+}
+
+/*===========================================================================*/
+static void cmd_stats(void)
+{
+	uint8_t f[4];
+
+	boot_log_dump();
+	clock_report();
+	rom_query_fault(f);
+	uart_printf_P(PSTR("\n\rSupply faults (hex): %x\n\rLogged faults: %u\n\r"),
+		adc_faults(), f[0]);
+	watchdog_dump();
+}
+
+/*===========================================================================*/
+static void cmd_settings(void)
+{
+	uart_printf_P(PSTR("hour mode: %S\n\ralarm: "),
+		(time.hour_mode == MODE_24H) ? PSTR("24h") : PSTR("12h"));
+	send_hhmm(alarm.hour, alarm.day_period, alarm.min);
+	uart_printf_P(PSTR(" %S\n\ralarm theme: %u\n\rmode: %c\n\rrtc drift correction (ppm): %d\n\r"),
+		alarm.active ? PSTR("on") : PSTR("off"), alarm.theme,
+		'1' + (display.mode - DISP_MODE_1), rom_query_rtc_cal());
+}
+
+/*===========================================================================*/
+static uint8_t cmd_telemetry(uint8_t argc, char **argv)
+{
+	if(argc == 2){
+		if(!strcmp_P(argv[1], PSTR("text"))) telemetry_set(TLM_TEXT);
+		else if(!strcmp_P(argv[1], PSTR("binary"))) telemetry_set(TLM_BINARY);
+		else return FALSE;
+	} else if(argc != 1){
+		return FALSE;
+	}
+	if(telemetry_mode() == TLM_BINARY) uart_send_string_p(PSTR("binary\n\r"));
+	else uart_send_string_p(PSTR("text\n\r"));
+	return TRUE;
+}
+
+/*===========================================================================*/
+/*
+* NTP-like time sync. The host sends its time of the day T1 (ms); the reply
+* carries T1 back, the clock time when the request was received (T2) and
+* the one right before the reply is sent (T3). The host computes the offset
+* and sends it back with "sync adjust". Offsets up to SHELL_SYNC_STEP_MS are
+* slewed, so the seconds never jump; larger ones are stepped.
+*/
+static uint8_t cmd_sync(uint8_t argc, char **argv)
+{
+	char *end;
+	uint32_t t1, t2 = time_of_day_ms();
+	int32_t ms;
+
+	if((argc == 2) && strcmp_P(argv[1], PSTR("adjust"))){
+		t1 = strtoul(argv[1], &end, 10);
+		if(*end || (t1 >= SHELL_DAY_MS)) return FALSE;
+		// T3 right before the reply goes out: the host knows its length
+		uart_tx_flush();
+		uart_printf_P(PSTR("SYNC %lu %lu %lu\n\r"), t1, t2, time_of_day_ms());
+		return TRUE;
+	}
+	if((argc != 3) || strcmp_P(argv[1], PSTR("adjust"))) return FALSE;
+	ms = strtol(argv[2], &end, 10);
+	if(*end || (ms <= -(int32_t)SHELL_DAY_MS) || (ms >= (int32_t)SHELL_DAY_MS)) return FALSE;
+	if((ms > SHELL_SYNC_STEP_MS) || (ms < -SHELL_SYNC_STEP_MS)){
+		ms += time_of_day_ms();
+		if(ms < 0) ms += SHELL_DAY_MS;
+		else if(ms >= (int32_t)SHELL_DAY_MS) ms -= SHELL_DAY_MS;
+		time_of_day_set((uint32_t)ms);
+		rom_journal_checkpoint();
+		uart_send_string_p(PSTR("step\n\r"));
+	} else {
+		// ms to RTC ticks (256 per second)
+		ms = (ms * 32) / 125;
+		timer_rtc_slew((int16_t)ms);
+		uart_printf_P(PSTR("slew %ld ticks\n\r"), ms);
+	}
+	return TRUE;
+}
+
+/*===========================================================================*/
+/*
+* Hands over to the bootloader (boot/bootloader.c) once the reply is out.
+* The peripherals are stopped as for sleeping, so the high voltage is off and
+* no EEPROM write is left halfway. Doesn't return: the bootloader restarts
+* the system once the update is done, or if the host doesn't show up
+*/
+static void run_bootloader(void)
+{
+	peripherals_disable(RTC_DISABLE);
+	BOOST_SET(DISABLE);
+	cli();
+	GPIOR0 = BOOT_MAGIC;
+	// function pointers are word addresses
+	((void (*)(void))(BOOT_START / 2))();
+}
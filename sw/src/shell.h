@@ -0,0 +1,44 @@
+/**
+ * @file shell.h
+ * @brief Serial command shell
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#ifndef SHELL_H
+#define SHELL_H
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include "config.h"
+
+#include <stdint.h>
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Command line length, including the terminating null
+#define SHELL_LINE_SIZE	32
+// Maximum number of words in a command line
+#define SHELL_ARGS_MAX	4
+
+// Time sync: larger corrections (ms) are stepped, smaller ones slewed
+#define SHELL_SYNC_STEP_MS	500
+#define SHELL_DAY_MS		86400000UL
+
+// Loopback: echo ends after the line is quiet for this time (ms)
+#define SHELL_LOOPBACK_TIMEOUT	500
+
+/******************************************************************************
+******************** F U N C T I O N   P R O T O T Y P E S ********************
+******************************************************************************/
+
+void shell_init(void);
+void shell_poll(volatile state_t *state);
+uint8_t shell_loopback(void);
+
+#endif	/* SHELL_H */
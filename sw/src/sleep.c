@@ -15,24 +15,33 @@
 
 #include "sleep.h"
 #include "adc.h"
+#include "buttons.h"
 #include "buzzer.h"
+#include "clock.h"
 #include "config.h"
+#include "eeprom.h"
 #include "external_interrupt.h"
+#include "init.h"
+#include "log.h"
 #include "menu_alarm.h"
 #include "timers.h"
 #include "uart.h"
 #include "util.h"
+#include "watchdog.h"
 
 #include <stdint.h>
 #include <avr/sleep.h>		/* Macros for handling spleep routines */
 #include <avr/interrupt.h>
 #include <avr/io.h>
-#include <util/delay.h>
+#include <avr/pgmspace.h>
 
 /******************************************************************************
 ******************* C O N S T A N T   D E F I N I T I O N S *******************
 ******************************************************************************/
 
+// Tag of the log messages (see log.h)
+#define LOG_TAG		"sleep"
+
 enum {
 	DISABLE_PERIPHERALS,
 	SLEEP_CPU,
@@ -68,7 +77,7 @@ void go_to_sleep(volatile state_t *state, volatile uint8_t mode)
 			case DISABLE_PERIPHERALS:
 				// disable all system and external peripheral
 				if(mode == RTC_ENABLE)
-					uart_send_string("\n\rGood Bye   ");
+					LOG_I("Good Bye");
 				peripherals_disable(mode);
 				step = SLEEP_CPU;
 				break;
@@ -112,15 +121,30 @@ void go_to_sleep(volatile state_t *state, volatile uint8_t mode)
 			case ENABLE_SYSTEM:
 				// enable all system and external peripherals
 				peripherals_enable();
-				uart_send_string("\n\rWhat's Up!");
-				// check system voltages
-				_delay_ms(2000);
+				boot_log_start();
+				LOG_I("What's Up!");
+				boot_log(BOOT_BANNER);
+				// report how long the time journal capture took
+				if(rom_journal_latency > ROM_JOURNAL_MAX_US)
+					LOG_W("Journal capture (us): %u, over the bound", rom_journal_latency);
+				else if(rom_journal_latency)
+					LOG_D("Journal capture (us): %u", rom_journal_latency);
+				rom_journal_latency = 0;
+				// check system voltages, once the boost output settles
+				adc_hv_settle();
+				boot_log(BOOT_SETTLE);
 				if(!adc_voltages_test()){
 				    system_reset = TRUE;
 				    *state = SYSTEM_RESET;				    
 				} else {
+					adc_monitor(ENABLE);
+					boot_log(BOOT_VOLTAGES);
 					if(alarm.triggered) *state = ALARM_TRIGGERED;
+#ifdef FAST_BOOT
+					else *state = DISPLAY_TIME;
+#else
 					else *state = SYSTEM_INTRO;
+#endif
 				}
 				sys = TRUE;				
 				break;
@@ -141,8 +165,9 @@ void go_to_sleep(volatile state_t *state, volatile uint8_t mode)
 * - ADC
 * - USART
 * - Timers
-* - Buttons' external interrupt (External power ISR is still active)
+* - Buttons' sampling (External power ISR is still active)
 * - RTC only if entering PWR_DOWN sleep mode. Otherwise, keep running
+* - Watchdog: the system state loops stop feeding it
 *
 * * Boost is not explicitly disabled since the absence of power adapter
 * 	immediately disables the boost controller. What must be done is to
@@ -153,12 +178,16 @@ void go_to_sleep(volatile state_t *state, volatile uint8_t mode)
 */
 void peripherals_disable(volatile uint8_t mode)
 {
+	watchdog_set(DISABLE);
+	clock_set(CLK_SLOW);
 	adc_set(DISABLE);
 	uart_set(DISABLE);
 	buzzer_set(DISABLE);
 	timer_leds_set(DISABLE, 0, 0, 0);
 	timer_base_set(DISABLE);
 	buttons_set(DISABLE);
+	// finish any pending EEPROM write before sleeping
+	rom_flush();
 	// Disable RTC only if entering POWER DOWN
 	if(mode == RTC_DISABLE)
 		timer_rtc_set(DISABLE);
@@ -172,8 +201,9 @@ void peripherals_disable(volatile uint8_t mode)
 * - ADC
 * - USART
 * - Timers
-* - Buttons' external interrupt (External power ISR is still active)
+* - Buttons' sampling (External power ISR is still active)
 * - RTC always enabled when waking up
+* - Watchdog, fed by the system state loops from now on
 * * Buttons' pull-ups also enabled
 */
 void peripherals_enable(void)
@@ -185,6 +215,7 @@ void peripherals_enable(void)
 	buttons_set(ENABLE);
 	timer_rtc_set(ENABLE);	// Always enable RTC
 	BOOST_SET(ENABLE);
+	watchdog_set(ENABLE);
 	// missing I2C
 }
 
@@ -0,0 +1,169 @@
+/**
+ * @file telemetry.c
+ * @brief Framed binary telemetry through the serial port
+ *
+ * In TLM_BINARY mode, the time sent every second by the RTC ISR, the rail
+ * voltages and the system events go out as small binary frames instead of
+ * text lines:
+ *
+ *   0x00 | COBS( header | payload | CRC-8 ) | 0x00
+ *
+ * COBS (Consistent Overhead Byte Stuffing) removes the 0x00 bytes of the
+ * frame with a single byte of overhead, so a 0x00 always marks a frame
+ * boundary and the host resyncs right after a lost byte. The time takes 9
+ * bytes, instead of the 10 of "HH:MM:SS\n\r". Text messages (boot reports,
+ * shell replies) are still sent as they are, between frames: the host
+ * decoder (tools/tlm_decode.c) shows them as text.
+ *
+ * The default mode is selected with TELEMETRY_BINARY in config.h, and the
+ * shell "telemetry" command changes it at run time.
+ *
+ * @date 19.10.2026
+ *
+ */
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include "telemetry.h"
+#include "adc.h"
+#include "clock.h"
+#include "config.h"
+#include "menu_alarm.h"
+#include "menu_time.h"
+#include "timers.h"
+#include "uart.h"
+#include "util.h"
+
+#include <stdint.h>
+#include <util/crc16.h>
+
+/******************************************************************************
+*************** G L O B A L   V A R S   D E F I N I T I O N S *****************
+******************************************************************************/
+
+#ifdef TELEMETRY_BINARY
+static uint8_t mode = TLM_BINARY;
+#else
+static uint8_t mode = TLM_TEXT;
+#endif
+static uint8_t seq = 0;
+
+/******************************************************************************
+******************* F U N C T I O N   D E F I N I T I O N S *******************
+******************************************************************************/
+
+static void send_frame(uint8_t type, uint8_t *payload, uint8_t n);
+static void put16(uint8_t *p, uint16_t v);
+
+/*===========================================================================*/
+void telemetry_set(uint8_t m)
+{
+	mode = m;
+}
+
+/*===========================================================================*/
+uint8_t telemetry_mode(void)
+{
+	return mode;
+}
+
+/*===========================================================================*/
+/*
+* TIME frame. Sent by the RTC ISR every second
+*/
+void telemetry_time(void)
+{
+	uint8_t p[TLM_TIME_SIZE];
+
+	p[0] = hour_to_24(time.hour, time.day_period);
+	p[1] = time.min;
+	p[2] = time.sec;
+	p[3] = 0;
+	if(time.stale) p[3] |= TLM_TIME_STALE;
+	if(alarm.active) p[3] |= TLM_TIME_ALARM;
+	if(display.set) p[3] |= TLM_TIME_DISPLAY;
+	send_frame(TLM_FRAME_TIME, p, TLM_TIME_SIZE);
+}
+
+/*===========================================================================*/
+/*
+* STATUS frame: rail voltages and loop load. The ADC sampler must be running
+*/
+void telemetry_status(void)
+{
+	uint8_t p[TLM_STATUS_SIZE];
+	uint16_t cv[4], over;
+
+	if(mode != TLM_BINARY) return;
+
+	adc_rails(cv);
+	for(uint8_t i = 0; i < 4; i++)
+		put16(&p[2 * i], cv[i]);
+	p[8] = adc_faults();
+	clock_stats(CLK_SLOW, &p[9], &p[10], &over);
+	clock_stats(CLK_FAST, &p[11], &p[12], &over);
+	put16(&p[13], over);
+	send_frame(TLM_FRAME_STATUS, p, TLM_STATUS_SIZE);
+}
+
+/*===========================================================================*/
+/*
+* EVENT frame. Only sent in binary mode: in text mode, events are already
+* reported by their own messages
+*/
+void telemetry_event(uint8_t code, uint16_t a, uint16_t b)
+{
+	uint8_t p[TLM_EVENT_SIZE];
+
+	if(mode != TLM_BINARY) return;
+
+	p[0] = code;
+	put16(&p[1], a);
+	put16(&p[3], b);
+	send_frame(TLM_FRAME_EVENT, p, TLM_EVENT_SIZE);
+}
+
+/*-----------------------------------------------------------------------------
+-------------------------- L O C A L   F U N C T I O N S ----------------------
+-----------------------------------------------------------------------------*/
+
+/*===========================================================================*/
+/*
+* Builds the frame (header, payload and CRC) and sends it COBS encoded.
+* Every block starts with the distance to the next 0x00 byte, which is left
+* out. Frames are shorter than 254 bytes, so there's no block size limit.
+*/
+static void send_frame(uint8_t type, uint8_t *payload, uint8_t n)
+{
+	uint8_t f[TLM_PAYLOAD_MAX + 2];
+	uint8_t i, start, crc = 0;
+
+	f[0] = TLM_HEADER(type, seq);
+	seq++;
+	for(i = 0; i < n; i++)
+		f[i + 1] = payload[i];
+	n++;
+	for(i = 0; i < n; i++)
+		crc = _crc8_ccitt_update(crc, f[i]);
+	f[n++] = crc;
+
+	uart_send_char(TLM_DELIMITER);
+	start = 0;
+	for(i = 0; i <= n; i++){
+		if((i == n) || (f[i] == 0)){
+			uart_send_char((char)(i - start + 1));
+			while(start < i) uart_send_char((char)f[start++]);
+			start = i + 1;
+		}
+	}
+	uart_send_char(TLM_DELIMITER);
+}
+
+/*===========================================================================*/
+static void put16(uint8_t *p, uint16_t v)
+{
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+}
@@ -0,0 +1,82 @@
+/**
+ * @file telemetry.h
+ * @brief Framed binary telemetry through the serial port
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include <stdint.h>
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Output modes
+#define TLM_TEXT		0		// human-readable (former output)
+#define TLM_BINARY		1		// framed binary telemetry
+
+/*
+* Frame header: frame type (bits 7..4) and a sequence number (bits 3..0),
+* so the host can count the lost frames
+*/
+#define TLM_FRAME_TIME		0x1
+#define TLM_FRAME_STATUS	0x2
+#define TLM_FRAME_EVENT		0x3
+
+#define TLM_HEADER(type, seq)	(((type) << 4) | ((seq) & 0x0F))
+#define TLM_TYPE(h)				((h) >> 4)
+#define TLM_SEQ(h)				((h) & 0x0F)
+
+/*
+* Payloads. Multi-byte fields are little endian
+* - TIME (4 bytes): hour (0 to 23), minutes, seconds, TLM_TIME_x flags
+* - STATUS (15 bytes): V_HV, V_CTL_REG, V_IN and MCU rail (uint16, 10mV
+*   units), supply faults (ADC_FAULT_x), loop load at 2MHz and 16MHz (average
+*   and maximum, %), loops over 1ms at 16MHz (uint16)
+* - EVENT (5 bytes): TLM_EV_x code and two uint16 arguments
+*/
+#define TLM_TIME_SIZE		4
+#define TLM_STATUS_SIZE		15
+#define TLM_EVENT_SIZE		5
+#define TLM_PAYLOAD_MAX		15
+
+// TIME flags
+#define TLM_TIME_STALE		0x01	// time restored from the journal
+#define TLM_TIME_ALARM		0x02	// alarm enabled
+#define TLM_TIME_DISPLAY	0x04	// tubes on
+
+// Events
+#define TLM_EV_BOOT			0x01	// boot done: boot time (ms), 0
+#define TLM_EV_FAULT		0x02	// supply fault: faults, HV trip latency (us)
+#define TLM_EV_ALARM		0x03	// alarm triggered: hour (0 to 23), minutes
+#define TLM_EV_TIME_SET		0x04	// time set through the shell: hour, minutes
+
+// Seconds between STATUS frames while the time is displayed
+#define TLM_STATUS_PERIOD	10
+
+/*
+* Frames are CRC-8 CCITT protected (header and payload), COBS encoded and
+* delimited by a 0x00 byte at both ends, so text sent in between can't be
+* taken for a frame
+*/
+#define TLM_DELIMITER		0x00
+
+/******************************************************************************
+******************** F U N C T I O N   P R O T O T Y P E S ********************
+******************************************************************************/
+
+void telemetry_set(uint8_t mode);
+uint8_t telemetry_mode(void);
+void telemetry_time(void);
+void telemetry_status(void);
+void telemetry_event(uint8_t code, uint16_t a, uint16_t b);
+
+#endif	/* TELEMETRY_H */
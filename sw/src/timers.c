@@ -13,17 +13,44 @@
 
 #include "timers.h"
 #include "buzzer.h"
+#include "clock.h"
 #include "config.h"
 
+#include <avr/interrupt.h>
 #include <avr/io.h>
 #include <stdint.h>
 #include <util/delay.h>
 
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Prescalers of the timers clocked from the system clock, so their timing
+// doesn't change with the CPU clock speed (see clock.c)
+#define TC3_CS_SLOW		(1<<CS31)				// 8
+#define TC3_CS_FAST		((1<<CS31) | (1<<CS30))	// 64
+#define TC3_CS_MASK		((1<<CS32) | (1<<CS31) | (1<<CS30))
+#define TC4_CS_SLOW		(1<<CS40)				// 1
+#define TC4_CS_FAST		(1<<CS41)				// 8
+#define TC4_CS_MASK		((1<<CS42) | (1<<CS41) | (1<<CS40))
+
 /******************************************************************************
 *************** G L O B A L   V A R S   D E F I N I T I O N S *****************
 ******************************************************************************/
 
 display_s display;
+// Prescalers of TC3 and TC4 for the current CPU clock
+static uint8_t tc3_cs = TC3_CS_SLOW;
+static uint8_t tc4_cs = TC4_CS_SLOW;
+// Milliseconds since the general timer was started. Incremented by its ISR
+volatile uint16_t base_ms = 0;
+
+// RTC drift correction (ppm), and the error accumulated so far (us)
+static int16_t rtc_ppm = 0;
+static int32_t rtc_error = 0;
+// RTC phase correction still to be slewed (ticks), and slew done this second
+static int16_t rtc_slew = 0;
+static uint8_t slew_done = FALSE;
 
 /******************************************************************************
 ******************* F U N C T I O N   D E F I N I T I O N S *******************
@@ -37,7 +64,7 @@ void display_init(void)
 	display.d2 = 0;
 	display.d3 = 0;
 	display.d4 = 0;
-	display.set = ON;	
+	display.set = OFF;	// each system state turns it on
 	display.fade_level[0] = 5;
 	display.fade_level[1] = 5;
 	display.fade_level[2] = 5;
@@ -79,6 +106,95 @@ void timer_rtc_set(uint8_t state){
 	}
 }
 
+/*===========================================================================*/
+/*
+* Sets the RTC drift correction, in ppm (per-device calibration, stored in
+* the EEPROM). Out of range values disable it.
+*/
+void timer_rtc_calibrate(int16_t ppm)
+{
+	if((ppm > RTC_PPM_MAX) || (ppm < -RTC_PPM_MAX)) ppm = 0;
+	rtc_ppm = ppm;
+	rtc_error = 0;
+}
+
+/*===========================================================================*/
+/*
+* Sets the RTC counter, that is, the fraction of the current second (in
+* 1/RTC_TICKS). The asynchronous prescaler is reset too, and a pending
+* overflow is discarded: the caller sets the time of the new second.
+*/
+void timer_rtc_phase_set(uint8_t ticks)
+{
+	while(ASSR & (1<<TCN2UB));
+	TCNT2 = ticks;
+	GTCCR |= (1<<PSRASY);
+	while(ASSR & (1<<TCN2UB));
+	TIFR2 = (1<<TOV2);
+	rtc_slew = 0;
+}
+
+/*===========================================================================*/
+/*
+* Requests a gradual RTC phase correction (ticks, positive to advance).
+* timer_rtc_slew_run() applies it one tick per second, that is, at 0.4%
+*/
+void timer_rtc_slew(int16_t ticks)
+{
+	rtc_slew = ticks;
+	slew_done = FALSE;
+}
+
+/*===========================================================================*/
+/*
+* Applies one tick of the pending phase correction per second. Called every
+* loop of display_time(). The counter is only written in the middle of the
+* second, so the overflow (the RTC ISR) can't be skipped nor doubled.
+*/
+void timer_rtc_slew_run(void)
+{
+	uint8_t t;
+
+	if(!rtc_slew) return;
+	t = TCNT2;
+	if(t < RTC_SLEW_LO){
+		slew_done = FALSE;
+	} else if((t < RTC_SLEW_HI) && !slew_done){
+		while(ASSR & (1<<TCN2UB));
+		if(rtc_slew > 0){
+			TCNT2 = t + 1;
+			rtc_slew--;
+		} else {
+			TCNT2 = t - 1;
+			rtc_slew++;
+		}
+		slew_done = TRUE;
+	}
+}
+
+/*===========================================================================*/
+/*
+* Called by the RTC ISR once per second, with the current second. Returns the
+* seconds to add: 1 normally, 2 to catch up with a slow crystal or 0 to wait
+* for the time to catch up with a fast one. Every second adds rtc_ppm us of
+* error, and a whole second is corrected only at RTC_DRIFT_SEC, so no second
+* the alarm may be waiting for is skipped.
+*/
+uint8_t timer_rtc_drift(uint8_t sec)
+{
+	rtc_error += rtc_ppm;
+	if(sec != RTC_DRIFT_SEC) return 1;
+	if(rtc_error >= 1000000L){
+		rtc_error -= 1000000L;
+		return 2;
+	}
+	if(rtc_error <= -1000000L){
+		rtc_error += 1000000L;
+		return 0;
+	}
+	return 1;
+}
+
 /*===========================================================================*/
 /*
 * TIMER COUNTER 3
@@ -131,19 +247,87 @@ void timer_leds_init(void)
 	//TCCR1B |= (1<<CS10);		// Prescaler 1; start TC1
 }
 
+/*===========================================================================*/
+/*
+* Retimes TC3 and TC4 for a new CPU clock speed. Running timers are switched
+* right away. Called by clock_set()
+*/
+void timer_clock(uint8_t speed)
+{
+	tc3_cs = (speed == CLK_FAST) ? TC3_CS_FAST : TC3_CS_SLOW;
+	tc4_cs = (speed == CLK_FAST) ? TC4_CS_FAST : TC4_CS_SLOW;
+	if(TCCR3B & TC3_CS_MASK) TCCR3B = (TCCR3B & ~TC3_CS_MASK) | tc3_cs;
+	if(TCCR4B & TC4_CS_MASK) TCCR4B = (TCCR4B & ~TC4_CS_MASK) | tc4_cs;
+}
+
 /*===========================================================================*/
 void timer_base_set(uint8_t state)
 {
 	if(state){
 		TIMSK3 |= (1<<OCIE3A);	// Interrupts for compare match
 		TCNT3 = 0;
-		TCCR3B |= (1<<CS31); 	// Prescaler 8. Start TC3
+		base_ms = 0;
+		TCCR3B |= tc3_cs; 		// 4us tick. Start TC3
 	} else {
-		TCCR3B &= ~((1<<CS32) | (1<<CS31) | (1<<CS31));	// Stop prescaler
+		TCCR3B &= ~TC3_CS_MASK;	// Stop prescaler
 		TIMSK3 &= ~(1<<OCIE3A);	// Disable interrupts
 	}
 }
 
+/*===========================================================================*/
+/*
+* Milliseconds since the general timer was started. Main context runs with
+* interrupts disabled, so a compare match still pending is counted too.
+*/
+uint16_t timer_base_now(void)
+{
+	uint8_t sreg = SREG;
+	uint16_t t;
+
+	cli();
+	t = base_ms;
+	if(TIFR3 & (1<<OCF3A)) t++;
+	SREG = sreg;
+	return t;
+}
+
+/*===========================================================================*/
+/*
+* Microseconds since the general timer was started (4us resolution, wraps
+* around after 65s). Used to time short code sections: with interrupts
+* disabled, they must take less than 2ms.
+*/
+uint32_t timer_base_us(void)
+{
+	uint8_t sreg = SREG;
+	uint8_t t;
+	uint16_t ms;
+
+	cli();
+	// if the compare match happens between both reads, read again
+	do {
+		t = TCNT3;
+		ms = timer_base_now();
+	} while(TCNT3 < t);
+	SREG = sreg;
+	return (uint32_t)ms * 1000 + (uint32_t)t * 4;
+}
+
+/*===========================================================================*/
+/*
+* Waits for n ms with interrupts enabled, the same way the system states do,
+* so the ISRs (and base_ms) keep running. The general timer must be enabled.
+*/
+void timer_base_wait(uint16_t ms)
+{
+	while(ms--){
+		sei();
+		while(!loop);
+		loop = FALSE;
+		cli();
+	}
+}
+
 /*===========================================================================*/
 void timer_buzzer_set(uint8_t state, uint16_t note)
 {
@@ -151,9 +335,9 @@ void timer_buzzer_set(uint8_t state, uint16_t note)
 		TCNT4 = 0;
 		OCR4A = note;
 		TCCR4A |= (1<<COM4A0);
-		TCCR4B |= (1<<CS40);	// No prescaler, start PWM
+		TCCR4B |= tc4_cs;		// F_CPU clock, start PWM
 	} else {
-		TCCR4B &= ~((1<<CS42) | (1<<CS41) | (1<<CS40));
+		TCCR4B &= ~TC4_CS_MASK;
 		TCCR4A &= ~((1<<COM4A1) | (1<<COM4A0));
 	}
 }
@@ -162,17 +346,19 @@ void timer_buzzer_set(uint8_t state, uint16_t note)
 void timer_leds_set(uint8_t state, uint8_t r, uint8_t g, uint8_t b)
 {
 	if(state){
-		if((B_LED != b) || (R_LED != r) || (G_LED != g)){
-			R_LED = r;
-			G_LED = g;
-			B_LED = b;
+		// compare registers are double buffered in fast PWM mode; there's no
+		// need to restart the counters (which would glitch the outputs)
+		R_LED = r;
+		G_LED = g;
+		B_LED = b;
+		if(!(TCCR0B & (1<<CS00))){
 			TCNT0 = 0;
 			TCNT1 = 0;
 			TCCR0A |= (1<<COM0A1) | (1<<COM0B1);
 			TCCR1A |= (1<<COM1A1);
 			TCCR0B |= (1<<CS00);		// no prescaler
 			TCCR1B |= (1<<CS10);		// no prescaler
-		}		
+		}
 	} else {
 		TCCR0B &= ~((1<<CS01) | (1<<CS00));
 		TCCR1B &= ~((1<<CS11) | (1<<CS10));
@@ -182,4 +368,4 @@ void timer_leds_set(uint8_t state, uint8_t r, uint8_t g, uint8_t b)
 		G_LED = g;
 		B_LED = b;
 	}
-}
\ No newline at end of file
+}
@@ -33,11 +33,24 @@ typedef volatile struct {
 } display_s;
 
 extern display_s display;
+extern volatile uint16_t base_ms;
 
 /******************************************************************************
 ******************* C O N S T A N T   D E F I N I T I O N S *******************
 ******************************************************************************/
 
+// RTC drift correction limits (ppm). Positive: the crystal runs slow
+#define RTC_PPM_MAX		500
+// Second of the minute where the correction is applied (far from the alarm)
+#define RTC_DRIFT_SEC	30
+
+// RTC counter ticks per second (32.768KHz crystal, prescaler 128)
+#define RTC_TICKS		256
+// Phase slew: one tick per second, applied while the RTC counter is in this
+// range, far from the overflow
+#define RTC_SLEW_LO		128
+#define RTC_SLEW_HI		192
+
 // LED Register Counters 
 #define R_LED			OCR0A
 #define G_LED			OCR0B
@@ -50,12 +63,22 @@ extern display_s display;
 void display_init(void);
 
 void timer_rtc_set(uint8_t state);
+void timer_rtc_calibrate(int16_t ppm);
+uint8_t timer_rtc_drift(uint8_t sec);
+void timer_rtc_phase_set(uint8_t ticks);
+void timer_rtc_slew(int16_t ticks);
+void timer_rtc_slew_run(void);
 
 void timer_base_init(void);
 void timer_buzzer_init(void);
 void timer_leds_init(void);
 
+void timer_clock(uint8_t speed);
+
 void timer_base_set(uint8_t state);
+uint16_t timer_base_now(void);
+uint32_t timer_base_us(void);
+void timer_base_wait(uint16_t ms);
 void timer_buzzer_set(uint8_t state, uint16_t note);
 void timer_leds_set(uint8_t state, uint8_t r, uint8_t g, uint8_t b);
 
@@ -12,10 +12,18 @@
 ******************************************************************************/
 
 #include "uart.h"
+#include "clock.h"
 #include "config.h"
+#include "fixed.h"
+#include "timers.h"
+#include "watchdog.h"
 
+#include <avr/interrupt.h>
 #include <avr/io.h>
+#include <stdarg.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <avr/pgmspace.h>	/* Program Memory Strings handling */
 #include <util/delay.h>
 
@@ -23,13 +31,75 @@
 ******************* C O N S T A N T   D E F I N I T I O N S *******************
 ******************************************************************************/
 
-#define BAUD_REGISTER 	((uint16_t)(F_CPU/(8*BAUD)-1))
+/*
+* Baud rate register for a CPU clock, rounded to the nearest value, and the
+* resulting baud rate error (per mil). The tolerance is the receiver error
+* the datasheet recommends for 8 data bits, no parity.
+*/
+#if UART_U2X
+#define UART_DIV		8
+#define UART_BAUD_TOL	15
+#else
+#define UART_DIV		16
+#define UART_BAUD_TOL	20
+#endif
+#define UBRR_FOR(f)		(((f) + (UART_DIV * BAUD) / 2) / (UART_DIV * BAUD) - 1)
+#define BAUD_FOR(f)		(((f) * 1000) / (UART_DIV * (UBRR_FOR(f) + 1)))
+#define BAUD_ERROR(f)	((BAUD_FOR(f) > BAUD * 1000) ? \
+							((BAUD_FOR(f) - BAUD * 1000) / BAUD) : ((BAUD * 1000 - BAUD_FOR(f)) / BAUD))
+
+#define BAUD_REGISTER 	((uint16_t)UBRR_FOR(F_CPU))
+// Same baud rate, CPU running at 8 * F_CPU (see clock.c)
+#define BAUD_REGISTER_FAST	((uint16_t)UBRR_FOR(8 * F_CPU))
+
+// Both clock speeds must reach BAUD within tolerance
+#if (UBRR_FOR(F_CPU) > 4095) || (UBRR_FOR(8 * F_CPU) > 4095)
+#error "BAUD out of the UART range for this F_CPU"
+#elif BAUD_ERROR(F_CPU) > UART_BAUD_TOL
+#error "BAUD error out of tolerance at F_CPU (try UART_U2X)"
+#elif BAUD_ERROR(8 * F_CPU) > UART_BAUD_TOL
+#error "BAUD error out of tolerance at 8 * F_CPU (try UART_U2X)"
+#endif
+
+// uart_printf_P() conversion flags
+#define FMT_LEFT		0x01	// '-': pad on the right
+#define FMT_ZERO		0x02	// '0': pad with zeros
+#define FMT_LONG		0x04	// 'l': 32 bits argument
+#define FMT_NEG			0x08	// negative number
+
+// Formatting benchmark: calls per version
+#define BENCH_RUNS		8
+
+/******************************************************************************
+*************** G L O B A L   V A R S   D E F I N I T I O N S *****************
+******************************************************************************/
+
+// Set once a char has been sent. TXC is only meaningful after that
+static uint8_t tx_used = FALSE;
+
+/*
+* Receive ring: the RX complete ISR is the only producer and the system
+* states the only consumer. Same scheme as the buttons events queue.
+*/
+static volatile char rx_ring[UART_RX_SIZE];
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+
+/*
+* Transmit ring: the system states are the only producer and the UDRE ISR
+* the only consumer. While it's not empty, the UDRE interrupt is enabled.
+*/
+static volatile char tx_ring[UART_TX_SIZE];
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
 
 /******************************************************************************
 ******************* F U N C T I O N   D E F I N I T I O N S *******************
 ******************************************************************************/
 
 static uint8_t uart_flush(void);
+static void tx_drain_one(void);
+static uint8_t format_number(char *buf, uint32_t v, uint8_t base, uint8_t prec, uint8_t flags);
 
 /*===========================================================================*/
 void uart_init(void)
@@ -39,7 +109,11 @@ void uart_init(void)
 	UBRR2L = (uint8_t) (BAUD_REGISTER & 0x00FF);
 
 	/* Double transmission speed */
+#if UART_U2X
 	UCSR2A |= (1<<U2X);	// It provides more precise Baud rate
+#else
+	UCSR2A &= ~(1<<U2X);
+#endif
 
 	/* Asynchronous operation, no parity, 1 stop bit */
 	UCSR2C &= ~((1<<UMSEL1) | (1<<UMSEL0) | (1<<UPM1) | (1<<UPM0) | (1<<USBS));
@@ -49,16 +123,25 @@ void uart_init(void)
 }
 
 /*===========================================================================*/
+/*
+* Queues a char into the transmit ring, and returns. If the ring is full
+* (the main context runs with interrupts disabled, so the ISR may not be
+* draining it), the oldest char is sent by polling first. Code that blocks
+* with interrupts disabled calls uart_tx_flush() before.
+*/
 void uart_send_char( char data )
 {
-	/* Wait for empty transmit buffer */
-	while ( !( UCSR2A & (1<<UDRE)) );
-
-	/* Put data into buffer, sends the data */
-	UDR2 = data;
+	uint8_t sreg = SREG;
+	uint8_t next;
 
-	/* Wait empty buffer again  */
-	while ( !( UCSR2A & (1<<UDRE)) );
+	cli();
+	next = (tx_head + 1) & UART_TX_MASK;
+	if(next == tx_tail) tx_drain_one();
+	tx_ring[tx_head] = data;
+	tx_head = next;
+	/* Data register empty interrupt sends it */
+	UCSR2B |= (1<<UDRIE);
+	SREG = sreg;
 }
 
 /*===========================================================================*/
@@ -82,15 +165,274 @@ void uart_send_string_p(const char *s)
 }
 
 /*===========================================================================*/
+/*
+* Formatted print, format string in FLASH. A small subset of printf():
+*   %[-][0][width][.prec][l](d|u|x|c|s|S), and %%
+* - 'l': the argument is 32 bits long (int32_t, uint32_t)
+* - .prec: fixed-point integers. The last prec digits are printed after a
+*   decimal point: uart_printf_P(PSTR("%.3lu V"), mv) prints "12,345 V"
+* - %s: string in RAM; %S: string in FLASH
+* The output is queued into the transmit ring.
+*/
+void uart_printf_P(const char *fmt, ...)
+{
+	va_list ap;
+	char c, buf[16];	// up to 13 chars, plus zero padding
+	const char *s;
+	uint8_t flags, width, prec, n;
+	uint32_t v;
+
+	va_start(ap, fmt);
+	while((c = pgm_read_byte(fmt++))){
+		if(c != '%'){
+			uart_send_char(c);
+			continue;
+		}
+		flags = 0;
+		width = 0;
+		prec = 0;
+		c = pgm_read_byte(fmt++);
+		if(c == '-'){
+			flags |= FMT_LEFT;
+			c = pgm_read_byte(fmt++);
+		}
+		if(c == '0'){
+			flags |= FMT_ZERO;
+			c = pgm_read_byte(fmt++);
+		}
+		while((c >= '0') && (c <= '9')){
+			width = width * 10 + (c - '0');
+			c = pgm_read_byte(fmt++);
+		}
+		if(c == '.'){
+			c = pgm_read_byte(fmt++);
+			while((c >= '0') && (c <= '9')){
+				prec = prec * 10 + (c - '0');
+				c = pgm_read_byte(fmt++);
+			}
+			if(prec > 10) prec = 10;
+		}
+		if(c == 'l'){
+			flags |= FMT_LONG;
+			c = pgm_read_byte(fmt++);
+		}
+
+		s = buf;
+		switch(c){
+			case 'd':
+				if(flags & FMT_LONG) v = (uint32_t)va_arg(ap, int32_t);
+				else v = (uint32_t)(int32_t)va_arg(ap, int);
+				if((int32_t)v < 0){
+					flags |= FMT_NEG;
+					v = -v;
+				}
+				n = format_number(buf, v, 10, prec, flags);
+				break;
+			case 'u':
+			case 'x':
+				if(flags & FMT_LONG) v = va_arg(ap, uint32_t);
+				else v = va_arg(ap, unsigned int);
+				n = format_number(buf, v, (c == 'u') ? 10 : 16, prec, flags);
+				break;
+			case 'c':
+				buf[0] = (char)va_arg(ap, int);
+				n = 1;
+				break;
+			case 's':
+				s = va_arg(ap, const char *);
+				n = strlen(s);
+				break;
+			case 'S':
+				s = va_arg(ap, const char *);
+				n = strlen_P(s);
+				break;
+			case '\0':
+				va_end(ap);
+				return;
+			default:
+				// '%%' and unknown conversions: print the char
+				uart_send_char(c);
+				continue;
+		}
+
+		// zero padding goes between the sign and the digits
+		if((flags & FMT_ZERO) && !(flags & FMT_LEFT) && (s == buf)){
+			uint8_t sign = (flags & FMT_NEG) ? 1 : 0;
+			n -= sign;
+			while((n + sign < width) && (n < sizeof(buf) - 1)) buf[n++] = '0';
+			if(sign) buf[n++] = '-';
+		}
+		if(!(flags & FMT_LEFT)) while(width > n){
+			uart_send_char(' ');
+			width--;
+		}
+		if(width > n) width -= n;
+		else width = 0;
+		if(s != buf){
+			if(c == 'S') uart_send_string_p(s);
+			else uart_send_string(s);
+		} else {
+			// numbers are built backwards
+			while(n) uart_send_char(buf[--n]);
+		}
+		while(width--) uart_send_char(' ');
+	}
+	va_end(ap);
+}
+
+/*===========================================================================*/
+/*
+* Formatting cost of uart_printf_P() against the call chain it replaces, for
+* the same output line. The transmit ring is emptied before every call and
+* the line fits in it, so only the formatting and queueing time is measured.
+* Runs at CLK_FAST so each call fits within a timer tick period; the results
+* are given in CPU cycles at 16MHz (same count at any clock speed).
+*/
+void uart_printf_bench(void)
+{
+	char str[8];
+	uint32_t t, t_printf = 0, t_chain = 0;
+	uint32_t mv = 16012;
+	uint16_t ms = 73;
+	uint8_t faults = 0x05, i;
+
+	clock_set(CLK_FAST);
+	for(i = 0; i < BENCH_RUNS; i++){
+		uart_tx_flush();
+		t = timer_base_us();
+		uart_printf_P(PSTR("\n\rHV: %.2lu V, faults %02x, %4u ms"), mv / 10, faults, ms);
+		t_printf += timer_base_us() - t;
+
+		uart_tx_flush();
+		t = timer_base_us();
+		uart_send_string_p(PSTR("\n\rHV: "));
+		fx_format(str, mv);
+		uart_send_string(str);
+		uart_send_string_p(PSTR(" V, faults "));
+		if(faults < 0x10) uart_send_char('0');
+		utoa(faults, str, 16);
+		uart_send_string(str);
+		uart_send_string_p(PSTR(", "));
+		if(ms < 1000) uart_send_char(' ');
+		if(ms < 100) uart_send_char(' ');
+		if(ms < 10) uart_send_char(' ');
+		utoa(ms, str, 10);
+		uart_send_string(str);
+		uart_send_string_p(PSTR(" ms"));
+		t_chain += timer_base_us() - t;
+	}
+	uart_tx_flush();
+	clock_set(CLK_SLOW);
+
+	// us at 16MHz to cycles, averaged
+	uart_printf_P(PSTR("\n\rFormat cost (cycles/call): printf %lu, chain %lu\n\r"),
+		(t_printf * 16) / BENCH_RUNS, (t_chain * 16) / BENCH_RUNS);
+}
+
+/*===========================================================================*/
+/*
+* Waits until the transmit ring is empty, and the last char is in the UART
+*/
+void uart_tx_flush(void)
+{
+	uint8_t sreg = SREG;
+
+	cli();
+	while(tx_tail != tx_head) tx_drain_one();
+	SREG = sreg;
+}
+
+/*===========================================================================*/
+/*
+* TRUE if nothing is being sent: the transmit ring is empty and the last
+* char is out of the shift register (or the transmitter is disabled)
+*/
+uint8_t uart_tx_idle(void)
+{
+	if(!(UCSR2B & (1<<TXEN))) return TRUE;
+	if(tx_tail != tx_head) return FALSE;
+	return !tx_used || (UCSR2A & (1<<TXC));
+}
+
+/*===========================================================================*/
+/*
+* UART data register empty ISR: sends the next char of the transmit ring.
+* The interrupt is disabled once it's empty.
+*/
+void uart_tx_isr(void)
+{
+	if(tx_tail == tx_head){
+		UCSR2B &= ~(1<<UDRIE);
+		return;
+	}
+	/* Clear transmit complete flag (written with a 1) */
+	UCSR2A |= (1<<TXC);
+	tx_used = TRUE;
+	UDR2 = tx_ring[tx_tail];
+	tx_tail = (tx_tail + 1) & UART_TX_MASK;
+	if(tx_tail == tx_head) UCSR2B &= ~(1<<UDRIE);
+}
+
+/*===========================================================================*/
+/*
+* Blocking read. Chars already in the receive ring go first. Otherwise, it's
+* called with interrupts disabled, so the RX ISR can't run: poll the UART.
+* Any prompt still in the transmit ring is sent before waiting.
+* The watchdog is fed for UART_READ_TIMEOUT: if the host is gone, the
+* system restarts instead of waiting forever.
+*/
 char uart_read_char( void )
 {
-	/* Wait for data to be received */
-	while (!(UCSR2A & (1<<RXC)));
+	char c;
+	uint16_t ms = 0;
+	uint8_t n = 0;
+
+	if(uart_rx_get(&c)) return c;
+	uart_tx_flush();
+
+	/* Wait for data to be received. Polled every 50us */
+	while (!(UCSR2A & (1<<RXC))){
+		_delay_us(50);
+		if(++n < 20) continue;
+		n = 0;
+		if(ms < UART_READ_TIMEOUT){
+			ms++;
+			watchdog_feed();
+		}
+	}
 
 	/* Get and return received data from buffer */
 	return UDR2;
 }
 
+/*===========================================================================*/
+/*
+* Non-blocking read from the receive ring. Returns FALSE if it's empty
+*/
+uint8_t uart_rx_get(char *c)
+{
+	if(rx_tail == rx_head) return FALSE;
+	*c = rx_ring[rx_tail];
+	rx_tail = (rx_tail + 1) & UART_RX_MASK;
+	return TRUE;
+}
+
+/*===========================================================================*/
+/*
+* RX complete ISR: pushes the received char into the ring. If it's full, the
+* char is lost
+*/
+void uart_rx_isr(void)
+{
+	char c = UDR2;
+	uint8_t next = (rx_head + 1) & UART_RX_MASK;
+
+	if(next != rx_tail){
+		rx_ring[rx_head] = c;
+		rx_head = next;
+	}
+}
+
 /*===========================================================================*/
 void uart_set(uint8_t state)
 {
@@ -98,12 +440,42 @@ void uart_set(uint8_t state)
 		/* Enable receiver and transmitter */
 		UCSR2B |= (1<<RXEN)|(1<<TXEN);
 		uart_flush();
+		rx_tail = rx_head;
+		/* Receive interrupts */
+		UCSR2B |= (1<<RXCIE);
 	} else {
-		/* Disable receiver and transmitter */
-		UCSR2B &= ~((1<<RXEN)|(1<<TXEN));
+		/* Send what's queued. Disable receiver, transmitter and interrupts */
+		uart_tx_flush();
+		UCSR2B &= ~((1<<RXCIE)|(1<<UDRIE)|(1<<RXEN)|(1<<TXEN));
 	}
 }
 
+/*===========================================================================*/
+/*
+* Keeps the baud rate for a new CPU clock speed. The transmit ring and the
+* last char are completely sent first. Called by clock_set()
+*/
+void uart_clock(uint8_t speed)
+{
+	if(UCSR2B & (1<<TXEN)) uart_tx_flush();
+	if(tx_used && (UCSR2B & (1<<TXEN)))
+		while(!(UCSR2A & (1<<TXC)));
+	uart_baud(speed);
+}
+
+/*===========================================================================*/
+/*
+* Baud rate register for a CPU clock speed, right away: a char being sent is
+* garbled. Only for the power loss switch (clock_power_loss())
+*/
+void uart_baud(uint8_t speed)
+{
+	uint16_t ubrr = (speed == CLK_FAST) ? BAUD_REGISTER_FAST : BAUD_REGISTER;
+
+	UBRR2H = (uint8_t)(ubrr>>8);
+	UBRR2L = (uint8_t)(ubrr & 0x00FF);
+}
+
 /*===========================================================================*/
 uint8_t uart_check_rx(void)
 {
@@ -133,4 +505,49 @@ static uint8_t uart_flush(void)
 	}
 
 	return trash;
+}
+
+/*===========================================================================*/
+/*
+* Sends the oldest char of the transmit ring by polling. Interrupts disabled
+*/
+static void tx_drain_one(void)
+{
+	while(!(UCSR2A & (1<<UDRE)));
+	UCSR2A |= (1<<TXC);
+	tx_used = TRUE;
+	UDR2 = tx_ring[tx_tail];
+	tx_tail = (tx_tail + 1) & UART_TX_MASK;
+	if(tx_tail == tx_head) UCSR2B &= ~(1<<UDRIE);
+}
+
+/*===========================================================================*/
+/*
+* Converts v into buf, backwards (least significant digit first), and
+* returns the number of chars. With prec, a decimal point is placed before
+* the last prec digits, with leading zeros as needed ("0,05")
+*/
+static uint8_t format_number(char *buf, uint32_t v, uint8_t base, uint8_t prec, uint8_t flags)
+{
+	uint8_t n = 0, d;
+
+	if(!(flags & FMT_LONG)){
+		// 16 bits division is much cheaper on the AVR
+		uint16_t w = (uint16_t)v;
+		do {
+			if(prec && (n == prec)) buf[n++] = UART_DECIMAL_POINT;
+			d = w % base;
+			w /= base;
+			buf[n++] = (d < 10) ? ('0' + d) : ('a' + d - 10);
+		} while(w || (n <= prec));
+	} else {
+		do {
+			if(prec && (n == prec)) buf[n++] = UART_DECIMAL_POINT;
+			d = v % base;
+			v /= base;
+			buf[n++] = (d < 10) ? ('0' + d) : ('a' + d - 10);
+		} while(v || (n <= prec));
+	}
+	if(flags & FMT_NEG) buf[n++] = '-';
+	return n;
 }
\ No newline at end of file
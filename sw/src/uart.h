@@ -16,6 +16,24 @@
 
 #include <stdint.h>
 
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Receive ring size. Must be a power of 2
+#define UART_RX_SIZE	32
+#define UART_RX_MASK	(UART_RX_SIZE - 1)
+
+// Transmit ring size. Must be a power of 2
+#define UART_TX_SIZE	64
+#define UART_TX_MASK	(UART_TX_SIZE - 1)
+
+// Decimal separator of fixed-point numbers (same as fx_format())
+#define UART_DECIMAL_POINT	','
+
+// Blocking read: the watchdog is fed while waiting, up to this time (ms)
+#define UART_READ_TIMEOUT	60000
+
 /******************************************************************************
 ******************** F U N C T I O N   P R O T O T Y P E S ********************
 ******************************************************************************/
@@ -25,8 +43,17 @@ void uart_init(void);
 void uart_send_char(char data);
 void uart_send_string(const char *s);
 void uart_send_string_p(const char *s);
+void uart_printf_P(const char *fmt, ...);
+void uart_printf_bench(void);
+void uart_tx_flush(void);
+uint8_t uart_tx_idle(void);
+void uart_tx_isr(void);
 char uart_read_char(void);
+uint8_t uart_rx_get(char *c);
+void uart_rx_isr(void);
 void uart_set(uint8_t state);
 uint8_t uart_check_rx(void);
+void uart_clock(uint8_t speed);
+void uart_baud(uint8_t speed);
 
 #endif /* UART_H */
\ No newline at end of file
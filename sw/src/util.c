@@ -11,9 +11,7 @@
 ******************************************************************************/
 
 #include "util.h"
-#include "buzzer.h"
 #include "config.h"
-#include "external_interrupt.h"
 #include "menu_alarm.h"
 #include "menu_time.h"
 #include "timers.h"
@@ -23,19 +21,6 @@
 #include <avr/io.h>
 #include <util/delay.h>
 
-/******************************************************************************
-******************* C O N S T A N T   D E F I N I T I O N S *******************
-******************************************************************************/
-
-// Button time counts: These macros determine the time it takes for 
-// different flags within btnXYZ structure to be set (in milliseconds)
-#define BTN_DTCT_TIME   7		// Detect time to assume the button is pressed
-#define BTN_LOCK_TIME	30		// lock time after button released
-#define BTN_DLY1_TIME	300		// time for delay 1
-#define BTN_DLY2_TIME	65		// time for delay 2
-#define BTN_DLY3_TIME	2000	// time for delay 3
-#define BTN_BEEP_TIME	50		// duration of beep sound
-
 /******************************************************************************
 ******************* F U N C T I O N   D E F I N I T I O N S *******************
 ******************************************************************************/
@@ -77,68 +62,6 @@ void set_digit(uint8_t n)
 					PORTD |= (1<<PORTD7);		// wrong in schematic
 }
 
-/*===========================================================================*/
-/*	
-* Buttons' debounce routune.
-* Each button has its own structure. The function takes the respective button
-* pointer and, using counters for assessing the bounce time, it determines
-* the state the button is at.
-*/
-void buttons_check(btn_s *btn)
-{
-	switch(btn->state){
-
-		case BTN_IDLE:
-			if(!(btn->check)()) btn->count++;
-			else if(btn->count > 0) btn->count--;
-
-			if(btn->count == BTN_DTCT_TIME){
-				btn->action = TRUE;
-				btn->lock = TRUE;
-				btn->state = BTN_PUSHED;
-				btn->count = 0;
-				buzzer_set(ENABLE);
-			} else if(btn->count == 0){
-				btn->action = FALSE;
-				btn->lock = FALSE;
-				btn->query = FALSE;
-			}
-			break;
-
-		case BTN_PUSHED:
-			if(!(btn->check)()){
-				btn->count++;	
-			} else {
-				btn->count = 0;
-				btn->state = BTN_RELEASED;
-			}
-			if(btn->count == BTN_BEEP_TIME) buzzer_set(DISABLE);
-			if(btn->count == BTN_DLY1_TIME) btn->delay1 = TRUE;
-			if((btn->delay1) && (!(btn->count % BTN_DLY2_TIME))) btn->delay2 = TRUE;
-			if(btn->count >= BTN_DLY3_TIME) btn->delay3 = TRUE;
-			break;
-
-		case BTN_RELEASED:
-			if((btn->check)())
-				btn->count++;
-			if(btn->count == BTN_LOCK_TIME){
-				btn->query = FALSE;
-				btn->action = FALSE;
-				btn->lock = FALSE;
-				btn->state = BTN_IDLE;
-				btn->count = 0;
-				btn->delay1 = FALSE;
-				btn->delay2 = FALSE;
-				btn->delay3 = FALSE;
-				buzzer_set(DISABLE);
-			}
-			break;
-		default:
-			break;
-	}
-	
-}
-
 /*===========================================================================*/
 void led_blink(uint8_t n, uint8_t time)
 {
@@ -195,6 +118,75 @@ void update_time_variables(void)
     alarm.h_units = alarm.hour % 10;
 }
 
+/*===========================================================================*/
+/*
+* Hour (0 to 23) of an hour and day period in the current hour mode
+*/
+uint8_t hour_to_24(uint8_t hour, uint8_t period)
+{
+	if(time.hour_mode == MODE_12H){
+		if(hour == 12) hour = 0;
+		if(period == PERIOD_PM) hour += 12;
+	}
+	return hour;
+}
+
+/*===========================================================================*/
+/*
+* Hour and day period in the current hour mode, from an hour 0 to 23
+*/
+void hour_from_24(uint8_t h24, uint8_t *hour, uint8_t *period)
+{
+	*period = (h24 < 12) ? PERIOD_AM : PERIOD_PM;
+	if(time.hour_mode == MODE_24H){
+		*hour = h24;
+	} else {
+		*hour = h24 % 12;
+		if(*hour == 0) *hour = 12;
+	}
+}
+
+/*===========================================================================*/
+/*
+* Time of the day (ms since midnight), including the fraction of the current
+* second held by the RTC counter (3.9ms resolution). With interrupts
+* disabled, an RTC overflow may be pending: its second is counted as well.
+*/
+uint32_t time_of_day_ms(void)
+{
+	uint8_t t = TCNT2;
+	uint32_t s;
+
+	s = ((uint32_t)hour_to_24(time.hour, time.day_period) * 3600) + 
+		((uint16_t)time.min * 60) + time.sec;
+	// counter just wrapped around and the ISR has not run yet
+	if((TIFR2 & (1<<TOV2)) && (t < (RTC_TICKS / 2))){
+		s++;
+		if(s == 86400UL) s = 0;
+	}
+	return (s * 1000) + (((uint16_t)t * 125) >> 5);
+}
+
+/*===========================================================================*/
+/*
+* Sets the time of the day (ms since midnight), including the RTC phase.
+* Called with interrupts disabled
+*/
+void time_of_day_set(uint32_t ms)
+{
+	uint32_t s = ms / 1000;
+	uint8_t h, p;
+
+	timer_rtc_phase_set((uint8_t)(((ms % 1000) * 32) / 125));
+	hour_from_24((uint8_t)(s / 3600), &h, &p);
+	time.hour = h;
+	time.day_period = p;
+	time.min = (uint8_t)((s / 60) % 60);
+	time.sec = (uint8_t)(s % 60);
+	time.stale = FALSE;
+	update_time_variables();
+}
+
 /*===========================================================================*/
 /*
 * Random number algorithm.
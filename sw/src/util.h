@@ -13,8 +13,6 @@
 *******************	I N C L U D E   D E P E N D E N C I E S	*******************
 ******************************************************************************/
 
-#include "external_interrupt.h"
-
 #include <stdint.h>
 
 /******************************************************************************
@@ -25,11 +23,14 @@ void set_tube(uint8_t k);
 void set_digit(uint8_t n);
 void set_digit_t(uint8_t n);
 
-void buttons_check(btn_s *btn);
 void bin_to_ascii(char *p, uint8_t bin);
 void led_blink(uint8_t n, uint8_t time);
 uint8_t check_alarm(void);
 void update_time_variables(void);
+uint8_t hour_to_24(uint8_t hour, uint8_t period);
+void hour_from_24(uint8_t h24, uint8_t *hour, uint8_t *period);
+uint32_t time_of_day_ms(void);
+void time_of_day_set(uint32_t ms);
 uint8_t random_number(uint8_t seed);
 
 #endif	/* UTIL_H */
\ No newline at end of file
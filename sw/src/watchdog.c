@@ -0,0 +1,186 @@
+/**
+ * @file watchdog.c
+ * @brief Watchdog supervisor and reset cause log
+ *
+ * The watchdog runs while the system is powered by the adapter: it's
+ * started and stopped with the rest of the peripherals (sleep.c). The
+ * general timer ISR feeds it once per tick, but only if the system state
+ * loop took the previous tick. A loop stuck with interrupts disabled (e.g. a
+ * blocking UART read) or enabled (e.g. waiting for a flag that never comes)
+ * stops feeding it, and the system restarts after WDT_TIMEOUT instead of
+ * freezing with the high voltage on. Deliberate long waits (the production
+ * test) feed it themselves.
+ *
+ * Every reset is logged into an EEPROM ring (eeprom.c), with the reset
+ * flags (MCUSR) and the system state that was running:
+ * - The flags are taken before main(): after a watchdog reset, the watchdog
+ *   keeps running with its shortest timeout until WDRF is cleared. The
+ *   bootloader hands them over in GPIOR1, as it clears MCUSR itself. Its
+ *   own watchdog resets (after an update, or when the host stays silent)
+ *   come as BOOT_RESET_UPDATE or BOOT_RESET_IDLE instead of WDRF.
+ * - The state is kept by every feed in a RAM section that isn't initialized
+ *   at startup, so it survives a reset. A check byte tells whether it's
+ *   still valid (it isn't after a power-on reset). It's not logged after
+ *   the bootloader restarts: the state is just the one where the "update"
+ *   command was received.
+ *
+ * @date 19.10.2026
+ *
+ */
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include "watchdog.h"
+#include "config.h"
+#include "eeprom.h"
+#include "log.h"
+#include "uart.h"
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
+#include <stdint.h>
+#include <util/delay.h>
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// Tag of the log messages (see log.h)
+#define LOG_TAG		"wdt"
+
+/******************************************************************************
+*************** G L O B A L   V A R S   D E F I N I T I O N S *****************
+******************************************************************************/
+
+// Survive a reset: not initialized at startup
+static uint8_t reset_flags __attribute__((section(".noinit")));
+static uint8_t last_state __attribute__((section(".noinit")));
+static uint8_t last_check __attribute__((section(".noinit")));	// ~last_state
+
+/******************************************************************************
+******************* F U N C T I O N   D E F I N I T I O N S *******************
+******************************************************************************/
+
+static void watchdog_early(void) __attribute__((naked, used, section(".init3")));
+static const char *cause_name(uint8_t flags);
+
+/*===========================================================================*/
+/*
+* Logs the cause of the last reset, and the state that was running. Called
+* once, before the system boots
+*/
+void watchdog_init(void)
+{
+	uint8_t state = WDT_STATE_NONE;
+
+	if((last_check == (uint8_t)~last_state) &&
+		!(reset_flags & (BOOT_RESET_UPDATE | BOOT_RESET_IDLE))) state = last_state;
+	rom_store_reset(reset_flags, state);
+	// unknown until the first feed
+	last_check = last_state;
+}
+
+/*===========================================================================*/
+void watchdog_set(uint8_t state)
+{
+	if(state) wdt_enable(WDT_TIMEOUT);
+	else wdt_disable();
+}
+
+/*===========================================================================*/
+/*
+* Scheduler feed. Executed from the general timer ISR, once per tick, if the
+* system state loop took the previous one
+*/
+void watchdog_tick(uint8_t state)
+{
+	wdt_reset();
+	last_state = state;
+	last_check = ~state;
+}
+
+/*===========================================================================*/
+/*
+* Feed from a deliberate wait, outside of the system state loops
+*/
+void watchdog_feed(void)
+{
+	wdt_reset();
+}
+
+/*===========================================================================*/
+/*
+* _delay_ms() that keeps the watchdog fed, for waits longer than WDT_TIMEOUT
+*/
+void watchdog_delay_ms(uint16_t ms)
+{
+	while(ms--){
+		_delay_ms(1);
+		wdt_reset();
+	}
+}
+
+/*===========================================================================*/
+/*
+* Reports the last reset at boot. A watchdog reset is a warning: it comes
+* with the state that hung
+*/
+void watchdog_report(void)
+{
+	reset_s r;
+
+	if(!rom_query_reset(0, &r)) return;
+	if(r.flags & (1<<WDRF)) LOG_W("Reset by the watchdog, in state %u", r.state);
+	else LOG_I("Reset: %S", cause_name(r.flags));
+}
+
+/*===========================================================================*/
+/*
+* Prints the newest records of the reset log (shell "stats")
+*/
+void watchdog_dump(void)
+{
+	reset_s r;
+
+	uart_send_string_p(PSTR("Resets, newest first (cause, flags hex, state):\n\r"));
+	for(uint8_t i = 0; i < WDT_DUMP_N; i++){
+		if(!rom_query_reset(i, &r)) break;
+		uart_printf_P(PSTR("%S, %x, %u\n\r"), cause_name(r.flags), r.flags, r.state);
+	}
+}
+
+/*-----------------------------------------------------------------------------
+-------------------------- L O C A L   F U N C T I O N S ----------------------
+-----------------------------------------------------------------------------*/
+
+/*===========================================================================*/
+/*
+* Runs before main(), right after the stack is set up. Plain code only: no
+* stack frame and no initialized RAM yet
+*/
+static void watchdog_early(void)
+{
+	reset_flags = MCUSR | GPIOR1;
+	MCUSR = 0;
+	GPIOR1 = 0;
+	wdt_disable();
+}
+
+/*===========================================================================*/
+/*
+* Main cause of a reset. Several flags may be set at once
+*/
+static const char *cause_name(uint8_t flags)
+{
+	if(flags & BOOT_RESET_UPDATE) return PSTR("update");
+	if(flags & BOOT_RESET_IDLE) return PSTR("update timeout");
+	if(flags & (1<<WDRF)) return PSTR("watchdog");
+	if(flags & (1<<PORF)) return PSTR("power-on");
+	if(flags & (1<<BORF)) return PSTR("brown-out");
+	if(flags & (1<<EXTRF)) return PSTR("external");
+	if(flags & (1<<JTRF)) return PSTR("JTAG");
+	return PSTR("jump to 0");
+}
@@ -0,0 +1,43 @@
+/**
+ * @file watchdog.h
+ * @brief Watchdog supervisor and reset cause log
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+/******************************************************************************
+*******************	I N C L U D E   D E P E N D E N C I E S	*******************
+******************************************************************************/
+
+#include <stdint.h>
+
+/******************************************************************************
+******************* C O N S T A N T   D E F I N I T I O N S *******************
+******************************************************************************/
+
+// A system state loop stuck for longer than this restarts the system
+// (avr/wdt.h timeout)
+#define WDT_TIMEOUT			WDTO_2S
+// Last system state, if unknown (e.g. power-on reset)
+#define WDT_STATE_NONE		0xFF
+// Reset log records printed by watchdog_dump()
+#define WDT_DUMP_N			4
+
+/******************************************************************************
+******************** F U N C T I O N   P R O T O T Y P E S ********************
+******************************************************************************/
+
+void watchdog_init(void);
+void watchdog_set(uint8_t state);
+void watchdog_tick(uint8_t state);
+void watchdog_feed(void);
+void watchdog_delay_ms(uint16_t ms);
+
+void watchdog_report(void);
+void watchdog_dump(void);
+
+#endif	/* WATCHDOG_H */
@@ -0,0 +1,158 @@
+/**
+ * @file fixed_check.c
+ * @brief Host check of the fixed-point ADC math against the float version
+ *
+ * Runs the previous float computations of adc.c and the fixed.c functions
+ * for every possible internal reference reading, and compares the resulting
+ * pass/fail limits:
+ * - Within the rail voltages accepted by the factory test (4V to 5V), the
+ *   results must be identical
+ * - Outside of it, the only differences accepted are float truncation
+ *   errors: the exact limit is an integer, and float ends up 1 count below
+ * It also reports the worst printed voltage difference, and the time taken
+ * by both versions on the host.
+ *
+ * avr-gcc uses 32 bits floats for both float and double, so the float
+ * version is written with float constants only.
+ *
+ * Build and run (from sw/):
+ *   gcc -O2 -I src -o fixed_check tools/fixed_check.c src/fixed.c
+ *   ./fixed_check
+ *
+ * Flash and cycle counts on the target are given by the makefile size
+ * report (avr-size) and the simulator; this tool only checks the results.
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#include "fixed.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct {
+	const char *name;
+	float v_f;			// nominal voltage at the ADC pin (V)
+	uint16_t v_mv;		// same, in mV
+	float div_f;		// resistor divider factor
+	uq6_10_t div_q;
+	uint8_t lo, hi;		// limits (%)
+} check_s;
+
+static const check_s checks[] = {
+	{"V_HV",      3.794f, 3794, 42.2f, UQ6_10(42.2), 85, 115},
+	{"V_HV_OFF",  0.273f,  273, 42.2f, UQ6_10(42.2), 85, 115},
+	{"V_CTL_REG", 2.12f,  2120, 3.78f, UQ6_10(3.78), 85, 115},
+	{"V_IN",      3.01f,  3010, 3.78f, UQ6_10(3.78), 80, 120},
+};
+
+static volatile uint32_t sink;
+
+/*===========================================================================*/
+static void float_limits(uint16_t ref_raw, const check_s *c, uint16_t *l)
+{
+	float v_dd = 1.1f * 1023.0f / ((float)ref_raw);
+
+	l[0] = (uint16_t)((c->v_f / v_dd) * 1023.0f);
+	l[1] = (uint16_t)(((float)l[0]) * (c->lo / 100.0f));
+	l[2] = (uint16_t)(((float)l[0]) * (c->hi / 100.0f));
+}
+
+/*===========================================================================*/
+static void fixed_limits(uint16_t ref_raw, const check_s *c, uint16_t *l)
+{
+	l[0] = fx_counts(c->v_mv, ref_raw, 1100);
+	l[1] = fx_percent(l[0], c->lo);
+	l[2] = fx_percent(l[0], c->hi);
+}
+
+/*===========================================================================*/
+/*
+* TRUE if the difference comes from a float truncation of an exact integer
+*/
+static int truncation_error(uint16_t ref_raw, const check_s *c, uint16_t *lf, uint16_t *lq)
+{
+	uint32_t nom = (uint32_t)c->v_mv * ref_raw;
+
+	if(nom % 1100) return 0;
+	if(lf[0] + 1 != lq[0]) return 0;
+	// limits computed from the right nominal value must match
+	lf[0] = lq[0];
+	lf[1] = (uint16_t)(((float)lf[0]) * (c->lo / 100.0f));
+	lf[2] = (uint16_t)(((float)lf[0]) * (c->hi / 100.0f));
+	return (lf[1] == lq[1]) && (lf[2] == lq[2]);
+}
+
+/*===========================================================================*/
+int main(void)
+{
+	uint32_t errors = 0, truncations = 0, i;
+	uint16_t raw, v;
+	float worst = 0;
+	clock_t t;
+
+	for(raw = 1; raw <= 1023; raw++){
+		float v_dd = 1.1f * 1023.0f / ((float)raw);
+		// readings are 12 bits in the firmware
+		uint16_t v_dd_mv = fx_vdd(raw << 2, 1100);
+		uint8_t good_f = (v_dd < 5.0f) && (v_dd > 4.0f);
+		uint8_t good_q = (v_dd_mv < 5000) && (v_dd_mv > 4000);
+
+		// a rail voltage of 50V or more isn't a plausible reading
+		if((good_f != good_q) && (raw >= 23)){
+			printf("v_dd pass/fail differs: ref_raw %u\n", raw);
+			errors++;
+		}
+		for(i = 0; i < sizeof(checks)/sizeof(check_s); i++){
+			uint16_t lf[3], lq[3];
+			float_limits(raw, &checks[i], lf);
+			fixed_limits(raw, &checks[i], lq);
+			if((lf[0] == lq[0]) && (lf[1] == lq[1]) && (lf[2] == lq[2])) continue;
+			if(!good_f && truncation_error(raw, &checks[i], lf, lq)){
+				truncations++;
+				continue;
+			}
+			printf("%s limits differ: ref_raw %u: float %u/%u/%u, fixed %u/%u/%u\n",
+				checks[i].name, raw, lf[0], lf[1], lf[2], lq[0], lq[1], lq[2]);
+			errors++;
+		}
+		// printed voltages, over the rail voltages the system can run with
+		if(!good_f) continue;
+		for(v = 0; v <= 1023; v++){
+			for(i = 0; i < sizeof(checks)/sizeof(check_s); i++){
+				float f = ((float)v * v_dd * checks[i].div_f) / 1023.0f;
+				float q = fx_volts(v, raw, 1100, checks[i].div_q) / 1000.0f;
+				if(abs((int)((f - q) * 1000)) > worst * 1000) worst = f > q ? f - q : q - f;
+			}
+		}
+	}
+	printf("pass/fail limits: %lu differences, %lu float truncation errors\n",
+		(unsigned long)errors, (unsigned long)truncations);
+	printf("worst printed voltage difference: %.3f V\n", worst);
+
+	// host timing of the limits computation (not representative of the AVR,
+	// where float operations are done in software)
+	t = clock();
+	for(i = 0; i < 2000; i++){
+		for(raw = 200; raw < 300; raw++){
+			uint16_t l[3];
+			float_limits(raw, &checks[i & 3], l);
+			sink += l[0] + l[1] + l[2];
+		}
+	}
+	printf("float: %.3f ms\n", (clock() - t) * 1000.0 / CLOCKS_PER_SEC);
+	t = clock();
+	for(i = 0; i < 2000; i++){
+		for(raw = 200; raw < 300; raw++){
+			uint16_t l[3];
+			fixed_limits(raw, &checks[i & 3], l);
+			sink += l[0] + l[1] + l[2];
+		}
+	}
+	printf("fixed: %.3f ms\n", (clock() - t) * 1000.0 / CLOCKS_PER_SEC);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+/**
+ * @file loopback.c
+ * @brief Host check of the serial link at a given baud rate
+ *
+ * Sends blocks of random bytes and checks they come back unchanged, then
+ * reports the bytes lost or corrupted and the throughput. Either:
+ * - against the clock: the shell "loopback" command echoes every byte back
+ *   until the line is quiet for SHELL_LOOPBACK_TIMEOUT. Checks the baud
+ *   rate profile of the firmware end to end
+ * - with -w, with the TX and RX pins of the adapter wired together: checks
+ *   that the adapter and the host support the baud rate
+ * Blocks are smaller than the receive ring of the clock, and the next one
+ * is sent once the previous one is back, so no byte is lost to overruns.
+ *
+ * Build and run (from sw/):
+ *   gcc -O2 -o loopback tools/loopback.c tools/serial.c
+ *   ./loopback /dev/ttyUSB0 [-b baud] [-n blocks] [-w]
+ *
+ * Returns 0 if every byte came back.
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#include "serial.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// Below UART_RX_SIZE (uart.h): the clock takes them once per ms
+#define BLOCK_SIZE		16
+#define BLOCK_TIMEOUT	100
+// Same as SHELL_LOOPBACK_TIMEOUT in shell.h
+#define LOOPBACK_TIMEOUT	500
+
+/*===========================================================================*/
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1e6);
+}
+
+/*===========================================================================*/
+/*
+* Reads up to n bytes, until the timeout. Returns the bytes read
+*/
+static int read_block(int fd, uint8_t *buf, int n, double ms)
+{
+	int got = 0;
+	double t0 = now_ms();
+
+	while((got < n) && (now_ms() - t0 < ms)){
+		int r = read(fd, buf + got, n - got);
+		if(r > 0) got += r;
+		else usleep(200);
+	}
+	return got;
+}
+
+/*===========================================================================*/
+/*
+* Waits for a text reply containing s. Returns 0 on timeout
+*/
+static int wait_for(int fd, const char *s, double ms)
+{
+	char buf[256];
+	int n = 0;
+	double t0 = now_ms();
+
+	while((now_ms() - t0 < ms) && (n < (int)sizeof(buf) - 1)){
+		if(read(fd, buf + n, 1) != 1){
+			usleep(1000);
+			continue;
+		}
+		buf[++n] = '\0';
+		if(strstr(buf, s)) return 1;
+	}
+	return 0;
+}
+
+/*===========================================================================*/
+int main(int argc, char **argv)
+{
+	uint8_t out[BLOCK_SIZE], in[BLOCK_SIZE];
+	unsigned long baud = SERIAL_BAUD, blocks = 200, k, lost = 0, bad = 0;
+	int fd, i, wired = 0;
+	double t0;
+
+	if(argc < 2){
+		fprintf(stderr, "usage: %s port [-b baud] [-n blocks] [-w]\n", argv[0]);
+		return 2;
+	}
+	for(i = 2; i < argc; i++){
+		if(!strcmp(argv[i], "-b") && (i + 1 < argc)) baud = strtoul(argv[++i], NULL, 10);
+		else if(!strcmp(argv[i], "-n") && (i + 1 < argc)) blocks = strtoul(argv[++i], NULL, 10);
+		else if(!strcmp(argv[i], "-w")) wired = 1;
+	}
+	fd = serial_open(argv[1], baud);
+	if(fd < 0){
+		perror(argv[1]);
+		return 1;
+	}
+	if(!wired){
+		if(write(fd, "\rloopback\r", 10) != 10 || !wait_for(fd, "OK\n\r", 1000)){
+			fprintf(stderr, "no reply to the loopback command at %lu baud\n", baud);
+			return 1;
+		}
+		tcflush(fd, TCIFLUSH);
+	}
+
+	srand((unsigned)time(NULL));
+	t0 = now_ms();
+	for(k = 0; k < blocks; k++){
+		int got;
+
+		for(i = 0; i < BLOCK_SIZE; i++) out[i] = (uint8_t)rand();
+		if(write(fd, out, BLOCK_SIZE) != BLOCK_SIZE) break;
+		got = read_block(fd, in, BLOCK_SIZE, BLOCK_TIMEOUT);
+		lost += BLOCK_SIZE - got;
+		for(i = 0; i < got; i++) if(in[i] != out[i]) bad++;
+		// a short block leaves the next one out of step: drop late bytes
+		if(got < BLOCK_SIZE){
+			usleep(BLOCK_TIMEOUT * 1000);
+			tcflush(fd, TCIFLUSH);
+		}
+	}
+	t0 = now_ms() - t0;
+	printf("%lu baud: %lu bytes, %lu lost, %lu corrupted\n", baud, k * BLOCK_SIZE, lost, bad);
+	printf("round trip throughput: %.0f bytes/s (line limit %lu bytes/s each way)\n",
+		k * BLOCK_SIZE * 1000.0 / t0, baud / 10);
+	if(!wired){
+		if(wait_for(fd, "LOOPBACK END", LOOPBACK_TIMEOUT + 1000)) printf("clock: loopback end\n");
+		else printf("clock: no loopback end\n");
+	}
+	close(fd);
+	return (lost || bad) ? 1 : 0;
+}
@@ -0,0 +1,245 @@
+/**
+ * @file ram_check.c
+ * @brief Host check of the RAM usage against the map file
+ *
+ * Reads the static RAM sections (.data, .bss and .noinit) from the map file
+ * written by the linker, with the objects taking the most of them. With a
+ * serial port, it also runs the shell "ram" command (see ram.c) and checks:
+ * - The static RAM reported by the clock matches the map file: the firmware
+ *   running is the one that was built
+ * - Static RAM, stack peak and never used RAM add up to the SRAM size
+ * - The RAM never used is at least the margin (bytes, 128 by default). The
+ *   stack peak only covers what has run since the reset: run it after the
+ *   menus, the alarm melody and the shell commands have been used
+ * Without a port, the margin is checked against the RAM left for the stack.
+ *
+ * Build and run (from sw/), after "make build":
+ *   gcc -O2 -o ram_check tools/ram_check.c tools/serial.c
+ *   ./ram_check output/main.map
+ *   ./ram_check output/main.map /dev/ttyUSB0 [-b baud] [-m margin]
+ *
+ * Returns 0 if every check passes.
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#include "serial.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <time.h>
+#include <unistd.h>
+
+// ATmega324PB SRAM (RAMEND + 1 - RAMSTART)
+#define SRAM_SIZE		2048
+#define MARGIN			128
+#define TIMEOUT_MS		1000
+#define OBJECTS_MAX		64
+#define OBJECTS_SHOWN	8
+
+typedef struct {
+	char name[64];
+	unsigned long size;
+} object_s;
+
+static const char *sections[] = {".data", ".bss", ".noinit"};
+static unsigned long section_size[3];
+static object_s objects[OBJECTS_MAX];
+static int n_objects = 0;
+
+/*===========================================================================*/
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1e6);
+}
+
+/*===========================================================================*/
+/*
+* Index of a static RAM section (or one of its input sections, as
+* ".bss.name" with -fdata-sections), or -1
+*/
+static int section_index(const char *name)
+{
+	int i;
+	size_t n;
+
+	for(i = 0; i < 3; i++){
+		n = strlen(sections[i]);
+		if(!strncmp(name, sections[i], n) && ((name[n] == '\0') || (name[n] == '.')))
+			return i;
+	}
+	return -1;
+}
+
+/*===========================================================================*/
+static void add_object(const char *name, unsigned long size)
+{
+	const char *s = strrchr(name, '/');
+	int i;
+
+	s = s ? s + 1 : name;
+	for(i = 0; i < n_objects; i++){
+		if(!strcmp(objects[i].name, s)){
+			objects[i].size += size;
+			return;
+		}
+	}
+	if(n_objects == OBJECTS_MAX) return;
+	snprintf(objects[n_objects].name, sizeof(objects[0].name), "%.63s", s);
+	objects[n_objects++].size = size;
+}
+
+/*===========================================================================*/
+/*
+* Output sections start at the first column: ".bss  0x00800120  0x2c0".
+* Input sections are indented, and their name takes a line of its own if
+* it's too long: " .bss.name\n  0x00800120  0x2  output/file.o"
+*/
+static int load_map(const char *path)
+{
+	char s[512], name[256], file[256];
+	unsigned long addr, size;
+	int found = 0, k, n;
+	FILE *f = fopen(path, "r");
+
+	if(!f) return -1;
+	while(fgets(s, sizeof(s), f)){
+		n = sscanf(s, "%255s %lx %lx %255s", name, &addr, &size, file);
+		if((n < 1) || ((k = section_index(name)) < 0)) continue;
+		if(s[0] != ' '){
+			// output section: at its RAM address (0x800000 and up)
+			if((n >= 3) && (addr >= 0x800000)){
+				section_size[k] = size;
+				found = 1;
+			}
+			continue;
+		}
+		if(n == 1){
+			if(!fgets(s, sizeof(s), f)) break;
+			n = 1 + sscanf(s, "%lx %lx %255s", &addr, &size, file);
+		}
+		if((n == 4) && size && (addr >= 0x800000)) add_object(file, size);
+	}
+	fclose(f);
+	return found ? 0 : -1;
+}
+
+/*===========================================================================*/
+static int by_size(const void *a, const void *b)
+{
+	const object_s *x = a, *y = b;
+
+	return (y->size > x->size) - (y->size < x->size);
+}
+
+/*===========================================================================*/
+/*
+* Reads a line (without CR/LF) starting with prefix. Other lines (command
+* echo, "OK") are skipped. Returns 0, or -1 on timeout
+*/
+static int read_line(int fd, const char *prefix, char *line, int size)
+{
+	int n = 0;
+	char c;
+	double t0 = now_ms();
+
+	while(now_ms() - t0 < TIMEOUT_MS){
+		fd_set set;
+		struct timeval tv = {0, 10000};
+		FD_ZERO(&set);
+		FD_SET(fd, &set);
+		if(select(fd + 1, &set, NULL, NULL, &tv) <= 0) continue;
+		if(read(fd, &c, 1) != 1) continue;
+		if((c == '\n') || (c == '\r')){
+			line[n] = '\0';
+			if(n && !strncmp(line, prefix, strlen(prefix))) return 0;
+			n = 0;
+		} else if(n < size - 1){
+			line[n++] = c;
+		}
+	}
+	return -1;
+}
+
+/*===========================================================================*/
+int main(int argc, char **argv)
+{
+	char line[120];
+	const char *port = NULL;
+	unsigned long baud = SERIAL_BAUD, margin = MARGIN, total = 0;
+	unsigned used, stack, unused, peak, pool;
+	int fd, i, fail = 0;
+
+	if(argc < 2){
+		fprintf(stderr, "usage: %s main.map [port] [-b baud] [-m margin]\n", argv[0]);
+		return 2;
+	}
+	for(i = 2; i < argc; i++){
+		if(!strcmp(argv[i], "-b") && (i + 1 < argc)) baud = strtoul(argv[++i], NULL, 10);
+		else if(!strcmp(argv[i], "-m") && (i + 1 < argc)) margin = strtoul(argv[++i], NULL, 10);
+		else port = argv[i];
+	}
+	if(load_map(argv[1]) < 0){
+		fprintf(stderr, "%s: no RAM sections found\n", argv[1]);
+		return 1;
+	}
+	for(i = 0; i < 3; i++){
+		printf("%-8s %5lu\n", sections[i], section_size[i]);
+		total += section_size[i];
+	}
+	printf("static   %5lu of %d bytes, %lu left for the stack\n", total, SRAM_SIZE,
+		SRAM_SIZE - total);
+	qsort(objects, n_objects, sizeof(object_s), by_size);
+	for(i = 0; (i < n_objects) && (i < OBJECTS_SHOWN); i++)
+		printf("  %-20s %5lu\n", objects[i].name, objects[i].size);
+
+	if(!port){
+		if(total + margin > SRAM_SIZE){
+			fprintf(stderr, "less than %lu bytes left for the stack\n", margin);
+			return 1;
+		}
+		return 0;
+	}
+
+	fd = serial_open(port, baud);
+	if(fd < 0){
+		perror(port);
+		return 1;
+	}
+	if(write(fd, "\rram\r", 5) != 5) return 1;
+	if(read_line(fd, "RAM (bytes):", line, sizeof(line)) ||
+		(sscanf(line, "RAM (bytes): static %u, stack peak %u, never used %u",
+			&used, &stack, &unused) != 3)){
+		fprintf(stderr, "no reply to \"ram\": the clock must be displaying the time\n");
+		return 1;
+	}
+	printf("clock: static %u, stack peak %u, never used %u\n", used, stack, unused);
+	if(!read_line(fd, "Notes pool (bytes):", line, sizeof(line)) &&
+		(sscanf(line, "Notes pool (bytes): peak %u of %u", &peak, &pool) == 2))
+		printf("notes pool: peak %u of %u\n", peak, pool);
+	close(fd);
+
+	if(used != total){
+		fprintf(stderr, "static RAM differs from the map file (%u, %lu): "
+			"another firmware is running\n", used, total);
+		fail = 1;
+	}
+	if(used + stack + unused != SRAM_SIZE){
+		fprintf(stderr, "static, stack and unused RAM add up to %u, not %d\n",
+			used + stack + unused, SRAM_SIZE);
+		fail = 1;
+	}
+	if(unused < margin){
+		fprintf(stderr, "only %u bytes never used, margin is %lu\n", unused, margin);
+		fail = 1;
+	}
+	printf("%s\n", fail ? "FAIL" : "pass");
+	return fail;
+}
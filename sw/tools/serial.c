@@ -0,0 +1,90 @@
+/**
+ * @file serial.c
+ * @brief Serial port setup for the host tools
+ *
+ * Opens a serial port in raw mode (8N1, non-blocking reads) at any baud
+ * rate. The high baud rates that are exact for the clock at 2MHz (125000,
+ * 250000) are not in the POSIX speeds list: on Linux they are set with
+ * termios2 and BOTHER, which FTDI and CP210x adapters support. Elsewhere,
+ * only the standard speeds are available.
+ *
+ * This file can't include <termios.h> on Linux (it clashes with
+ * <asm/termbits.h>). The tools still use tcdrain() and tcflush() on the
+ * returned descriptor.
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#include "serial.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+#else
+#include <termios.h>
+#endif
+
+/*===========================================================================*/
+/*
+* Returns the file descriptor, or -1 (errno is set)
+*/
+int serial_open(const char *dev, unsigned long baud)
+{
+	int fd = open(dev, O_RDWR | O_NOCTTY);
+	int err;
+
+	if(fd < 0) return -1;
+#ifdef __linux__
+	struct termios2 tio;
+
+	if(ioctl(fd, TCGETS2, &tio) < 0) goto fail;
+	// raw mode, as cfmakeraw()
+	tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+	tio.c_oflag &= ~OPOST;
+	tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+	tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CBAUD | (CBAUD << IBSHIFT));
+	tio.c_cflag |= CS8 | CLOCAL | CREAD | BOTHER | (BOTHER << IBSHIFT);
+	tio.c_ispeed = baud;
+	tio.c_ospeed = baud;
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	if(ioctl(fd, TCSETS2, &tio) < 0) goto fail;
+	ioctl(fd, TCFLSH, TCIOFLUSH);
+#else
+	struct termios tio;
+	speed_t speed;
+
+	switch(baud){
+		case 9600: speed = B9600; break;
+		case 19200: speed = B19200; break;
+		case 38400: speed = B38400; break;
+		case 57600: speed = B57600; break;
+		case 115200: speed = B115200; break;
+		case 230400: speed = B230400; break;
+		default:
+			errno = EINVAL;
+			goto fail;
+	}
+	if(tcgetattr(fd, &tio) < 0) goto fail;
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	if(tcsetattr(fd, TCSANOW, &tio) < 0) goto fail;
+	tcflush(fd, TCIOFLUSH);
+#endif
+	return fd;
+
+fail:
+	err = errno;
+	close(fd);
+	errno = err;
+	return -1;
+}
@@ -0,0 +1,17 @@
+/**
+ * @file serial.h
+ * @brief Serial port setup for the host tools
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+// Baud rate of the clock by default (BAUD in config.h)
+#define SERIAL_BAUD		19200
+
+int serial_open(const char *dev, unsigned long baud);
+
+#endif	/* SERIAL_H */
@@ -0,0 +1,245 @@
+/**
+ * @file stream.c
+ * @brief Host tool that drives the tubes and LEDs of a clock
+ *
+ * Puts the clock in the REMOTE_DISPLAY state with the shell "stream"
+ * command, and streams frames (see remote.h) at the given rate. Frames are
+ * either a demo (a counter and a color wheel) or read from stdin, one per
+ * line: "DDDD FFFF R G B" (digits, '-' for blank, fade levels 0 to 5, and
+ * LEDs levels 0 to 255).
+ *
+ * Every frame is acknowledged with its sequence number, so the tool reports
+ * the throughput (acknowledged frames per second) and the latency (from the
+ * end of the frame transmission to its acknowledge) it measured. When it
+ * stops, the clock goes back to the time after REMOTE_TIMEOUT and reports
+ * the frames it received.
+ *
+ * Build and run (from sw/):
+ *   gcc -O2 -o stream tools/stream.c tools/serial.c
+ *   ./stream /dev/ttyUSB0 [-b baud] [-f fps] [-t seconds] [-i]
+ *
+ * At 19200 baud the line limits the rate to about 170 frames/s; a firmware
+ * built with BAUD=125000 takes frames as fast as the display shows them.
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#include "serial.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// Same as the frame constants of remote.h
+#define REMOTE_FRAME_SIZE	8
+#define REMOTE_DELIMITER	0x00
+#define REMOTE_TIMEOUT		2000
+
+static double sent_at[256];
+static unsigned long acked = 0;
+static double lat_sum = 0, lat_max = 0;
+
+/*===========================================================================*/
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1e6);
+}
+
+/*===========================================================================*/
+static uint8_t crc8_ccitt(uint8_t crc, uint8_t data)
+{
+	crc ^= data;
+	for(int i = 0; i < 8; i++)
+		crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	return crc;
+}
+
+/*===========================================================================*/
+/*
+* Frame plus CRC, COBS encoded and followed by a delimiter. Returns its
+* length
+*/
+static int encode(const uint8_t *frame, uint8_t *out)
+{
+	uint8_t f[REMOTE_FRAME_SIZE + 1], crc = 0;
+	int i, start = 0, o = 0, n = REMOTE_FRAME_SIZE + 1;
+
+	for(i = 0; i < REMOTE_FRAME_SIZE; i++){
+		f[i] = frame[i];
+		crc = crc8_ccitt(crc, f[i]);
+	}
+	f[REMOTE_FRAME_SIZE] = crc;
+	for(i = 0; i <= n; i++){
+		if((i == n) || (f[i] == 0)){
+			out[o++] = (uint8_t)(i - start + 1);
+			while(start < i) out[o++] = f[start++];
+			start = i + 1;
+		}
+	}
+	out[o++] = REMOTE_DELIMITER;
+	return o;
+}
+
+/*===========================================================================*/
+/*
+* Takes the acknowledges received so far
+*/
+static void read_acks(int fd)
+{
+	uint8_t ack;
+
+	while(read(fd, &ack, 1) == 1){
+		double lat = now_ms() - sent_at[ack];
+		acked++;
+		lat_sum += lat;
+		if(lat > lat_max) lat_max = lat;
+	}
+}
+
+/*===========================================================================*/
+static void demo_frame(unsigned long k, uint8_t *f)
+{
+	unsigned v = k % 10000;
+	unsigned h = (k * 4) % 768, l = h % 256;
+
+	f[1] = (uint8_t)(((v / 1000) << 4) | ((v / 100) % 10));
+	f[2] = (uint8_t)((((v / 10) % 10) << 4) | (v % 10));
+	f[3] = 0x55;
+	f[4] = 0x55;
+	f[5] = (h < 256) ? 255 - l : (h < 512) ? 0 : l;
+	f[6] = (h < 256) ? l : (h < 512) ? 255 - l : 0;
+	f[7] = (h < 256) ? 0 : (h < 512) ? l : 255 - l;
+}
+
+/*===========================================================================*/
+static int stdin_frame(uint8_t *f)
+{
+	char line[80], d[8], fl[8];
+	unsigned r, g, b;
+	uint8_t n[4], l[4];
+
+	if(!fgets(line, sizeof(line), stdin)) return 0;
+	if(sscanf(line, "%4s %4s %u %u %u", d, fl, &r, &g, &b) != 5) return -1;
+	for(int i = 0; i < 4; i++){
+		n[i] = ((d[i] >= '0') && (d[i] <= '9')) ? (uint8_t)(d[i] - '0') : 0x0F;
+		l[i] = ((fl[i] >= '0') && (fl[i] <= '5')) ? (uint8_t)(fl[i] - '0') : 5;
+	}
+	f[1] = (uint8_t)((n[0] << 4) | n[1]);
+	f[2] = (uint8_t)((n[2] << 4) | n[3]);
+	f[3] = (uint8_t)((l[0] << 4) | l[1]);
+	f[4] = (uint8_t)((l[2] << 4) | l[3]);
+	f[5] = (uint8_t)r;
+	f[6] = (uint8_t)g;
+	f[7] = (uint8_t)b;
+	return 1;
+}
+
+/*===========================================================================*/
+/*
+* Waits for a text reply containing s. Returns 0 on timeout
+*/
+static int wait_for(int fd, const char *s, double ms, int print)
+{
+	char buf[256];
+	int n = 0;
+	double t0 = now_ms();
+
+	while(now_ms() - t0 < ms){
+		char c;
+		if(read(fd, &c, 1) != 1){
+			usleep(1000);
+			continue;
+		}
+		if(print && (c != '\r')) putchar(c);
+		if(n < (int)sizeof(buf) - 1){
+			buf[n++] = c;
+			buf[n] = '\0';
+			if(strstr(buf, s)) return 1;
+		}
+	}
+	return 0;
+}
+
+/*===========================================================================*/
+int main(int argc, char **argv)
+{
+	uint8_t f[REMOTE_FRAME_SIZE], out[2 * REMOTE_FRAME_SIZE];
+	double fps = 50, secs = 10, t0, next;
+	unsigned long k, sent = 0, baud = SERIAL_BAUD;
+	int fd, from_stdin = 0, i, len = 0;
+
+	if(argc < 2){
+		fprintf(stderr, "usage: %s port [-b baud] [-f fps] [-t seconds] [-i]\n", argv[0]);
+		return 2;
+	}
+	for(i = 2; i < argc; i++){
+		if(!strcmp(argv[i], "-b") && (i + 1 < argc)) baud = strtoul(argv[++i], NULL, 10);
+		else if(!strcmp(argv[i], "-f") && (i + 1 < argc)) fps = atof(argv[++i]);
+		else if(!strcmp(argv[i], "-t") && (i + 1 < argc)) secs = atof(argv[++i]);
+		else if(!strcmp(argv[i], "-i")) from_stdin = 1;
+	}
+	fd = serial_open(argv[1], baud);
+	if(fd < 0){
+		perror(argv[1]);
+		return 1;
+	}
+	if(write(fd, "\rstream\r", 8) != 8 || !wait_for(fd, "OK", 1000, 0)){
+		fprintf(stderr, "no reply to the stream command\n");
+		return 1;
+	}
+	// the rest of the reply is not an acknowledge
+	usleep(20000);
+	tcflush(fd, TCIFLUSH);
+
+	// delimiter before the first frame, in case of noise in the line
+	out[0] = REMOTE_DELIMITER;
+	if(write(fd, out, 1) != 1) return 1;
+	t0 = next = now_ms();
+	for(k = 0; now_ms() - t0 < secs * 1000; k++){
+		int n;
+
+		f[0] = (uint8_t)k;
+		if(from_stdin){
+			int r = stdin_frame(f);
+			if(r == 0) break;
+			if(r < 0) continue;
+		} else {
+			demo_frame(k, f);
+		}
+		n = encode(f, out);
+		if(n > len) len = n;
+		if(write(fd, out, n) != n) break;
+		tcdrain(fd);
+		sent_at[f[0]] = now_ms();
+		sent++;
+		read_acks(fd);
+		if(fps > 0){
+			next += 1000.0 / fps;
+			while(now_ms() < next){
+				usleep(200);
+				read_acks(fd);
+			}
+		}
+	}
+	// last acknowledges
+	for(i = 0; i < 250; i++){
+		usleep(200);
+		read_acks(fd);
+	}
+	t0 = now_ms() - t0;
+	printf("frames sent %lu, acknowledged %lu, %.1f frames/s\n", sent, acked, acked * 1000.0 / t0);
+	if(acked) printf("latency: average %.2f ms, max %.2f ms\n", lat_sum / acked, lat_max);
+	printf("frame on the line: %d bytes, %.2f ms at %lu baud\n", len, len * 10000.0 / baud, baud);
+	// the clock goes back to the time and reports what it received
+	if(wait_for(fd, "bad: ", REMOTE_TIMEOUT + 1000, 1)) wait_for(fd, "\n", 100, 1);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,179 @@
+/**
+ * @file timesync.c
+ * @brief Host side of the serial time sync
+ *
+ * Synchronizes a clock with the host time, NTP style, through the shell
+ * "sync" command (see shell.c):
+ * - The host sends its time of the day T1 and timestamps the reply (T4).
+ *   The clock replies with T1, the time it received the request (T2) and
+ *   the time right before the reply (T3).
+ * - The serialization time of the request and the reply is known from the
+ *   baud rate, and removed from T1 and T4.
+ * - offset = ((T2 - T1) + (T3 - T4)) / 2, delay = (T4 - T1) - (T3 - T2).
+ *   Several rounds are run, and the one with the shortest delay is used
+ *   (the least affected by the USB adapter latency).
+ * - The correction is sent with "sync adjust": the clock slews small
+ *   offsets (one RTC tick, 3.9ms, per second) and steps large ones.
+ *
+ * Times are ms since the local midnight. The clock must be displaying the
+ * time, where the shell runs.
+ *
+ * Build and run (from sw/):
+ *   gcc -O2 -o timesync tools/timesync.c tools/serial.c
+ *   ./timesync /dev/ttyUSB0         (sync)
+ *   ./timesync /dev/ttyUSB0 -n      (only measure the offset)
+ *   ./timesync /dev/ttyUSB0 -b 125000   (firmware built with that BAUD)
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#include "serial.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// Same as SHELL_DAY_MS in shell.h
+#define SHELL_DAY_MS	86400000UL
+#define ROUNDS		8
+#define TIMEOUT_MS	1000
+// ms to send n chars (start, 8 data and stop bits)
+#define CHARS_MS(n)	((n) * 10000.0 / baud)
+
+static unsigned long baud = SERIAL_BAUD;
+
+/*===========================================================================*/
+static double now_ms(void)
+{
+	struct timespec ts;
+	struct tm tm;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	localtime_r(&ts.tv_sec, &tm);
+	return ((tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec) * 1000.0) + (ts.tv_nsec / 1e6);
+}
+
+/*===========================================================================*/
+/*
+* Difference a - b of two times of the day, within +/- 12h
+*/
+static double day_diff(double a, double b)
+{
+	double d = a - b;
+
+	if(d > SHELL_DAY_MS / 2) d -= SHELL_DAY_MS;
+	if(d < -(double)SHELL_DAY_MS / 2) d += SHELL_DAY_MS;
+	return d;
+}
+
+/*===========================================================================*/
+/*
+* Reads a line (without CR/LF) starting with prefix. Other lines (command
+* echo, "OK") are skipped. Returns the time its last char arrived, or -1
+*/
+static double read_line(int fd, const char *prefix, char *line, int size)
+{
+	int n = 0;
+	char c;
+	double t0 = now_ms(), t;
+
+	while((t = now_ms()) - t0 < TIMEOUT_MS){
+		fd_set set;
+		struct timeval tv = {0, 10000};
+		FD_ZERO(&set);
+		FD_SET(fd, &set);
+		if(select(fd + 1, &set, NULL, NULL, &tv) <= 0) continue;
+		if(read(fd, &c, 1) != 1) continue;
+		if((c == '\n') || (c == '\r')){
+			line[n] = '\0';
+			if(n && !strncmp(line, prefix, strlen(prefix))) return now_ms();
+			n = 0;
+		} else if(n < size - 1){
+			line[n++] = c;
+		}
+	}
+	return -1;
+}
+
+/*===========================================================================*/
+int main(int argc, char **argv)
+{
+	char cmd[40], line[80];
+	double best_offset = 0, best_delay = 1e9;
+	int fd, i, ok = 0, measure = 0;
+
+	if(argc < 2){
+		fprintf(stderr, "usage: %s port [-b baud] [-n]\n", argv[0]);
+		return 2;
+	}
+	for(i = 2; i < argc; i++){
+		if(!strcmp(argv[i], "-b") && (i + 1 < argc)) baud = strtoul(argv[++i], NULL, 10);
+		else if(!strcmp(argv[i], "-n")) measure = 1;
+	}
+	fd = serial_open(argv[1], baud);
+	if(fd < 0){
+		perror(argv[1]);
+		return 1;
+	}
+	// clear any partial line in the clock shell
+	write(fd, "\r", 1);
+	usleep(100000);
+	tcflush(fd, TCIFLUSH);
+
+	for(i = 0; i < ROUNDS; i++){
+		unsigned long r1, r2, r3;
+		double t1, t4, offset, delay;
+		int len;
+
+		t1 = now_ms();
+		len = snprintf(cmd, sizeof(cmd), "sync %lu\r", (unsigned long)t1);
+		write(fd, cmd, len);
+		tcdrain(fd);
+		t4 = read_line(fd, "SYNC ", line, sizeof(line));
+		if(t4 < 0){
+			fprintf(stderr, "round %d: no reply\n", i);
+			continue;
+		}
+		// a late reply of a previous round is discarded
+		if(sscanf(line, "SYNC %lu %lu %lu", &r1, &r2, &r3) != 3) continue;
+		if(r1 != (unsigned long)t1) continue;
+		// the request is received once its last char is sent, and the reply
+		// was sent before its last char arrived
+		t1 = (unsigned long)t1 + CHARS_MS(len);
+		t4 -= CHARS_MS(strlen(line) + 1);
+		offset = (day_diff(r2, t1) + day_diff(r3, t4)) / 2;
+		delay = day_diff(t4, t1) - day_diff(r3, r2);
+		printf("round %d: offset %+.1f ms, delay %.1f ms\n", i, offset, delay);
+		if(delay < best_delay){
+			best_delay = delay;
+			best_offset = offset;
+		}
+		ok++;
+		usleep(200000);
+	}
+	if(!ok){
+		fprintf(stderr, "no sync replies\n");
+		return 1;
+	}
+	printf("clock offset: %+.1f ms (delay %.1f ms, RTC resolution 3.9 ms)\n", best_offset, best_delay);
+
+	if(measure) return 0;
+	snprintf(cmd, sizeof(cmd), "sync adjust %ld\r", -(long)(best_offset + (best_offset < 0 ? -0.5 : 0.5)));
+	write(fd, cmd, strlen(cmd));
+	// "step" or "slew" reply, after the command echo
+	do {
+		if(read_line(fd, "s", line, sizeof(line)) < 0){
+			fprintf(stderr, "no adjust reply\n");
+			return 1;
+		}
+	} while(!strncmp(line, "sync", 4));
+	printf("%s\n", line);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file tlm_decode.c
+ * @brief Host decoder of the clock binary telemetry
+ *
+ * Reads the serial stream of a clock in TLM_BINARY mode (see telemetry.c)
+ * and prints one line per frame. Chunks between delimiters that are not
+ * valid frames are shown as text if they're printable (boot reports, shell
+ * replies), and counted as bad frames otherwise. Lost frames are counted
+ * from the gaps in the sequence numbers.
+ *
+ * Every line starts with the host time and an optional label, so the
+ * output of several clocks can be merged into a single log.
+ *
+ * Build and run (from sw/):
+ *   gcc -O2 -I src -o tlm_decode tools/tlm_decode.c
+ *   stty -F /dev/ttyUSB0 19200 raw -echo
+ *   ./tlm_decode clock1 < /dev/ttyUSB0
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#include "telemetry.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#define CHUNK_MAX	256
+
+static const char *label = "";
+static unsigned long frames = 0, bad = 0, lost = 0;
+static int last_seq = -1;
+
+/*===========================================================================*/
+/*
+* Same as _crc8_ccitt_update() of avr-libc: polynomial 0x07
+*/
+static uint8_t crc8_ccitt(uint8_t crc, uint8_t data)
+{
+	crc ^= data;
+	for(int i = 0; i < 8; i++)
+		crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+	return crc;
+}
+
+/*===========================================================================*/
+/*
+* Returns the decoded length, or -1 if the chunk is not valid COBS
+*/
+static int cobs_decode(const uint8_t *in, int n, uint8_t *out)
+{
+	int i = 0, o = 0;
+
+	while(i < n){
+		int code = in[i++];
+		if((code == 0) || (i + code - 1 > n)) return -1;
+		for(int j = 1; j < code; j++)
+			out[o++] = in[i++];
+		if((code < 0xFF) && (i < n)) out[o++] = 0;
+	}
+	return o;
+}
+
+/*===========================================================================*/
+static uint16_t get16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/*===========================================================================*/
+static void prefix(void)
+{
+	char t[16];
+	time_t now = time(NULL);
+
+	strftime(t, sizeof(t), "%H:%M:%S", localtime(&now));
+	printf("%s %s%s", t, label, *label ? " " : "");
+}
+
+/*===========================================================================*/
+static void print_frame(const uint8_t *f, int n)
+{
+	uint8_t type = TLM_TYPE(f[0]);
+	int seq = TLM_SEQ(f[0]);
+	const uint8_t *p = &f[1];
+
+	n--;
+	if(last_seq >= 0) lost += (unsigned long)((seq - last_seq - 1) & 0x0F);
+	last_seq = seq;
+	frames++;
+
+	prefix();
+	if((type == TLM_FRAME_TIME) && (n == TLM_TIME_SIZE)){
+		printf("TIME %02u:%02u:%02u%s%s%s\n", p[0], p[1], p[2],
+			(p[3] & TLM_TIME_STALE) ? " stale" : "",
+			(p[3] & TLM_TIME_ALARM) ? " alarm" : "",
+			(p[3] & TLM_TIME_DISPLAY) ? "" : " display-off");
+	} else if((type == TLM_FRAME_STATUS) && (n == TLM_STATUS_SIZE)){
+		printf("STATUS hv=%.2fV ctl=%.2fV in=%.2fV vdd=%.2fV faults=0x%02X "
+			"load2M=%u/%u%% load16M=%u/%u%% over=%u\n",
+			get16(&p[0]) / 100.0, get16(&p[2]) / 100.0, get16(&p[4]) / 100.0,
+			get16(&p[6]) / 100.0, p[8], p[9], p[10], p[11], p[12], get16(&p[13]));
+	} else if((type == TLM_FRAME_EVENT) && (n == TLM_EVENT_SIZE)){
+		uint16_t a = get16(&p[1]), b = get16(&p[3]);
+		switch(p[0]){
+			case TLM_EV_BOOT: printf("EVENT boot %u ms\n", a); break;
+			case TLM_EV_FAULT: printf("EVENT fault 0x%02X latency %u us\n", a, b); break;
+			case TLM_EV_ALARM: printf("EVENT alarm %02u:%02u\n", a, b); break;
+			case TLM_EV_TIME_SET: printf("EVENT time set %02u:%02u\n", a, b); break;
+			default: printf("EVENT 0x%02X %u %u\n", p[0], a, b); break;
+		}
+	} else {
+		printf("UNKNOWN type %u, %d bytes\n", type, n);
+	}
+}
+
+/*===========================================================================*/
+static void chunk(const uint8_t *c, int n)
+{
+	uint8_t f[CHUNK_MAX];
+	uint8_t crc = 0;
+	int len, i, text = 1;
+
+	if(n == 0) return;
+	len = cobs_decode(c, n, f);
+	if(len >= 2){
+		for(i = 0; i < len - 1; i++)
+			crc = crc8_ccitt(crc, f[i]);
+		if(crc == f[len - 1]){
+			print_frame(f, len - 1);
+			return;
+		}
+	}
+	for(i = 0; i < n; i++)
+		if(!isprint(c[i]) && (c[i] != '\r') && (c[i] != '\n')) text = 0;
+	if(!text){
+		bad++;
+		return;
+	}
+	// text lines, without the empty ones
+	for(i = 0; i < n; ){
+		int start = i;
+		while((i < n) && (c[i] != '\r') && (c[i] != '\n')) i++;
+		if(i > start){
+			prefix();
+			printf("TEXT %.*s\n", i - start, (const char *)&c[start]);
+		}
+		while((i < n) && ((c[i] == '\r') || (c[i] == '\n'))) i++;
+	}
+}
+
+/*===========================================================================*/
+int main(int argc, char **argv)
+{
+	uint8_t buf[CHUNK_MAX];
+	int n = 0, c;
+
+	if(argc > 1) label = argv[1];
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	while((c = getchar()) != EOF){
+		if(c == TLM_DELIMITER){
+			chunk(buf, n);
+			n = 0;
+		} else if(n < CHUNK_MAX){
+			buf[n++] = (uint8_t)c;
+		} else {
+			// no delimiter for too long: not this protocol
+			bad++;
+			n = 0;
+		}
+	}
+	chunk(buf, n);
+	fprintf(stderr, "%lu frames, %lu lost, %lu bad\n", frames, lost, bad);
+	return 0;
+}
@@ -0,0 +1,248 @@
+/**
+ * @file upload.c
+ * @brief Host firmware uploader for the UART bootloader
+ *
+ * Sends an application image (Intel HEX, as built by "make build") to the
+ * bootloader (boot/bootloader.c):
+ * - The shell "update" command hands the clock over to the bootloader. If
+ *   it is already running it (e.g. after an interrupted update), the
+ *   command is ignored
+ * - Sync: 'S' until the bootloader answers
+ * - Every page of the image is sent with its CRC, and resent if it isn't
+ *   acknowledged. A page is written and verified before the next one is
+ *   sent, so the transfer is paced by the FLASH write time (~9ms per page)
+ * - The CRC of the whole image is checked by the bootloader before it
+ *   marks the application valid and restarts it
+ * The EEPROM is left as is: the user settings survive the update.
+ *
+ * A full image (28KB) takes about 5s at 125000 baud, and about 20s at
+ * 19200 baud. The bootloader runs at the BAUD rate it was built with.
+ *
+ * Build and run (from sw/):
+ *   gcc -O2 -o upload tools/upload.c tools/serial.c
+ *   ./upload /dev/ttyUSB0 output/main.hex [-b baud]
+ *
+ * Returns 0 once the new firmware is running.
+ *
+ * @date 19.10.2026
+ *
+ */
+
+#include "serial.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// Same as in boot/bootloader.c (BOOT_START in config.h)
+#define PAGE_SIZE		128
+#define BOOT_START		0x7000
+#define BOOT_INFO		(BOOT_START - PAGE_SIZE)
+
+#define SYNC_TRIES		50
+#define REPLY_TIMEOUT	100
+#define PAGE_TIMEOUT	1000
+// CRC of the whole image in FLASH, at 2MHz
+#define DONE_TIMEOUT	3000
+#define PAGE_RETRIES	5
+
+static uint8_t image[BOOT_INFO];
+
+/*===========================================================================*/
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1e6);
+}
+
+/*===========================================================================*/
+/*
+* CRC-16/XMODEM, as _crc_xmodem_update() of avr-libc
+*/
+static uint16_t crc_update(uint16_t crc, uint8_t d)
+{
+	int i;
+
+	crc ^= (uint16_t)d << 8;
+	for(i = 0; i < 8; i++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+	return crc;
+}
+
+/*===========================================================================*/
+/*
+* Reads one byte, until the timeout. Returns -1 on timeout
+*/
+static int read_byte(int fd, double ms)
+{
+	uint8_t c;
+	double t0 = now_ms();
+
+	while(now_ms() - t0 < ms){
+		if(read(fd, &c, 1) == 1) return c;
+		usleep(200);
+	}
+	return -1;
+}
+
+/*===========================================================================*/
+/*
+* Loads an Intel HEX file into the image. Returns the image size in bytes,
+* or -1 if the file is not valid or doesn't fit below the info page
+*/
+static long load_hex(const char *path)
+{
+	char s[600];
+	unsigned long base = 0, size = 0;
+	FILE *f = fopen(path, "r");
+
+	if(!f) return -1;
+	memset(image, 0xFF, sizeof(image));
+	while(fgets(s, sizeof(s), f)){
+		unsigned n, addr, type, sum, b, i;
+
+		if(s[0] != ':') continue;
+		if(sscanf(s + 1, "%2x%4x%2x", &n, &addr, &type) != 3) break;
+		sum = n + (addr >> 8) + (addr & 0xFF) + type;
+		for(i = 0; i <= n; i++){
+			if(sscanf(s + 9 + 2 * i, "%2x", &b) != 1) goto error;
+			sum += b;
+			if((type == 0) && (i < n)){
+				unsigned long a = base + addr + i;
+				if(a >= sizeof(image)){
+					fprintf(stderr, "%s: 0x%04lx is past the application section\n", path, a);
+					goto error;
+				}
+				image[a] = b;
+				if(a + 1 > size) size = a + 1;
+			}
+		}
+		if(sum & 0xFF) goto error;
+		if(type == 1){
+			fclose(f);
+			return size;
+		}
+		// extended segment and linear addresses
+		if((type == 2) || (type == 4)){
+			if(sscanf(s + 9, "%4x", &b) != 1) break;
+			base = (type == 2) ? (unsigned long)b << 4 : (unsigned long)b << 16;
+		}
+	}
+error:
+	fclose(f);
+	return -1;
+}
+
+/*===========================================================================*/
+/*
+* Sends a command and waits for the single byte reply. On timeout, the
+* bootloader may still be waiting for the rest of a command: filler sync
+* bytes complete it, and the replies are dropped
+*/
+static int command(int fd, const uint8_t *cmd, int n, double ms)
+{
+	uint8_t fill[PAGE_SIZE + 8];
+	int r;
+
+	if(write(fd, cmd, n) != n) return -1;
+	r = read_byte(fd, ms);
+	if(r < 0){
+		memset(fill, 'S', sizeof(fill));
+		if(write(fd, fill, sizeof(fill)) != sizeof(fill)) return -1;
+		usleep(200000);
+		tcflush(fd, TCIFLUSH);
+	}
+	return r;
+}
+
+/*===========================================================================*/
+int main(int argc, char **argv)
+{
+	uint8_t cmd[PAGE_SIZE + 5];
+	unsigned long baud = SERIAL_BAUD;
+	long size;
+	int fd, i, k, pages, r, retries = 0;
+	uint16_t crc = 0;
+	double t0;
+
+	if(argc < 3){
+		fprintf(stderr, "usage: %s port file.hex [-b baud]\n", argv[0]);
+		return 2;
+	}
+	for(i = 3; i < argc; i++){
+		if(!strcmp(argv[i], "-b") && (i + 1 < argc)) baud = strtoul(argv[++i], NULL, 10);
+	}
+	size = load_hex(argv[2]);
+	if(size <= 0){
+		fprintf(stderr, "%s: not a valid application image\n", argv[2]);
+		return 1;
+	}
+	pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+	for(i = 0; i < pages * PAGE_SIZE; i++) crc = crc_update(crc, image[i]);
+
+	fd = serial_open(argv[1], baud);
+	if(fd < 0){
+		perror(argv[1]);
+		return 1;
+	}
+	// the application replies and jumps to the bootloader
+	if(write(fd, "\rupdate\r", 8) != 8) return 1;
+	usleep(300000);
+	tcflush(fd, TCIFLUSH);
+	for(i = 0; i < SYNC_TRIES; i++){
+		if(write(fd, "S", 1) != 1) return 1;
+		if(read_byte(fd, REPLY_TIMEOUT) == 'B') break;
+	}
+	if(i == SYNC_TRIES){
+		fprintf(stderr, "no reply from the bootloader at %lu baud\n", baud);
+		return 1;
+	}
+	// drop the replies to the extra sync bytes
+	usleep(REPLY_TIMEOUT * 1000);
+	tcflush(fd, TCIFLUSH);
+
+	printf("%ld bytes, %d pages, crc %04x\n", size, pages, crc);
+	t0 = now_ms();
+	for(k = 0; k < pages; k++){
+		uint16_t c = 0;
+
+		cmd[0] = 'P';
+		cmd[1] = k >> 8;
+		cmd[2] = k & 0xFF;
+		memcpy(cmd + 3, image + k * PAGE_SIZE, PAGE_SIZE);
+		for(i = 1; i < PAGE_SIZE + 3; i++) c = crc_update(c, cmd[i]);
+		cmd[PAGE_SIZE + 3] = c >> 8;
+		cmd[PAGE_SIZE + 4] = c & 0xFF;
+		for(i = 0; i < PAGE_RETRIES; i++){
+			r = command(fd, cmd, sizeof(cmd), PAGE_TIMEOUT);
+			if(r == 'K') break;
+			retries++;
+		}
+		if(i == PAGE_RETRIES){
+			fprintf(stderr, "\npage %d failed, the bootloader keeps waiting for an update\n", k);
+			return 1;
+		}
+		printf("\r%d/%d", k + 1, pages);
+		fflush(stdout);
+	}
+	cmd[0] = 'D';
+	cmd[1] = pages >> 8;
+	cmd[2] = pages & 0xFF;
+	cmd[3] = crc >> 8;
+	cmd[4] = crc & 0xFF;
+	r = command(fd, cmd, 5, DONE_TIMEOUT);
+	t0 = now_ms() - t0;
+	printf("\n%.1f s, %.0f bytes/s, %d pages resent\n", t0 / 1000, size * 1000.0 / t0, retries);
+	close(fd);
+	if(r != 'K'){
+		fprintf(stderr, "image CRC check failed, the bootloader keeps waiting for an update\n");
+		return 1;
+	}
+	printf("done: the new firmware is starting\n");
+	return 0;
+}